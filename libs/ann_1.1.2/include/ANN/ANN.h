@@ -701,6 +701,44 @@ const int ANN_N_SHRINK_RULES	= 4;	// number of shrink rules
 class ANNkdStats;				// stats on kd-tree
 class ANNkd_node;				// generic node in a kd-tree
 typedef ANNkd_node*	ANNkd_ptr;	// pointer to a kd-tree node
+class ANNmin_k;					// k-element priority queue
+class ANNpr_queue;				// priority queue of boxes
+
+//----------------------------------------------------------------------
+//	Search context
+//		The state of a standard or priority search, shared by the
+//		recursive search procedures. The searches which are given a
+//		context are reentrant: several threads can search the same tree
+//		at once as long as each one uses its own context. The queues
+//		of a context are kept from one search to the next, so reusing
+//		a context for many queries avoids any allocation per query.
+//		The searches without a context use a temporary one.
+//----------------------------------------------------------------------
+
+class DLL_API ANNsearchContext {
+public:
+	int				dim;				// dimension of space
+	ANNpoint		q;					// query point
+	double			maxErr;				// max tolerable squared error
+	ANNpointArray	pts;				// the points
+	ANNmin_k		*pointMK;			// set of k closest points
+	ANNpr_queue		*boxPQ;				// priority queue for boxes
+	int				ptsVisited;			// number of points visited
+
+	ANNsearchContext();
+	~ANNsearchContext();
+
+	void prepare(						// empty the queues, (re)allocated if needed
+		int				k,				// number of near neighbors
+		int				nBoxes = 0);	// size of the box queue (0 if unused)
+
+private:
+	int				mkSize;				// size of pointMK
+	int				pqSize;				// size of boxPQ
+
+	ANNsearchContext(const ANNsearchContext&);				// not copyable
+	ANNsearchContext& operator=(const ANNsearchContext&);
+};
 
 class DLL_API ANNkd_tree: public ANNpointSet {
 protected:
@@ -745,6 +783,14 @@ public:
 		ANNdistArray	dd,				// dist to near neighbors (modified)
 		double			eps=0.0);		// error bound
 
+	void annkSearch(					// reentrant k near neighbor search
+		ANNsearchContext& context,		// search state (modified)
+		ANNpoint		q,				// query point
+		int				k,				// number of near neighbors to return
+		ANNidxArray		nn_idx,			// nearest neighbor array (modified)
+		ANNdistArray	dd,				// dist to near neighbors (modified)
+		double			eps=0.0);		// error bound
+
 	void annkPriSearch( 				// priority k near neighbor search
 		ANNpoint		q,				// query point
 		int				k,				// number of near neighbors to return
@@ -752,6 +798,14 @@ public:
 		ANNdistArray	dd,				// dist to near neighbors (modified)
 		double			eps=0.0);		// error bound
 
+	void annkPriSearch( 				// reentrant priority k near neighbor search
+		ANNsearchContext& context,		// search state (modified)
+		ANNpoint		q,				// query point
+		int				k,				// number of near neighbors to return
+		ANNidxArray		nn_idx,			// nearest neighbor array (modified)
+		ANNdistArray	dd,				// dist to near neighbors (modified)
+		double			eps=0.0);		// error bound
+
 	int annkFRSearch(					// approx fixed-radius kNN search
 		ANNpoint		q,				// the query point
 		ANNdist			sqRad,			// squared radius of query ball
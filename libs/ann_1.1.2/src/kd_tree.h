@@ -47,8 +47,8 @@ class ANNkd_node{						// generic kd-tree node (empty shell)
 public:
 	virtual ~ANNkd_node() {}					// virtual distroyer
 
-	virtual void ann_search(ANNdist) = 0;		// tree search
-	virtual void ann_pri_search(ANNdist) = 0;	// priority search
+	virtual void ann_search(ANNdist, ANNsearchContext&) = 0;		// tree search
+	virtual void ann_pri_search(ANNdist, ANNsearchContext&) = 0;	// priority search
 	virtual void ann_FR_search(ANNdist) = 0;	// fixed-radius search
 
 	virtual void getStats(						// get tree statistics
@@ -110,8 +110,8 @@ public:
 	virtual void print(int level, ostream &out);// print node
 	virtual void dump(ostream &out);			// dump node
 
-	virtual void ann_search(ANNdist);			// standard search
-	virtual void ann_pri_search(ANNdist);		// priority search
+	virtual void ann_search(ANNdist, ANNsearchContext&);		// standard search
+	virtual void ann_pri_search(ANNdist, ANNsearchContext&);	// priority search
 	virtual void ann_FR_search(ANNdist);		// fixed-radius search
 };
 
@@ -176,8 +176,8 @@ public:
 	virtual void print(int level, ostream &out);// print node
 	virtual void dump(ostream &out);			// dump node
 
-	virtual void ann_search(ANNdist);			// standard search
-	virtual void ann_pri_search(ANNdist);		// priority search
+	virtual void ann_search(ANNdist, ANNsearchContext&);		// standard search
+	virtual void ann_pri_search(ANNdist, ANNsearchContext&);	// priority search
 	virtual void ann_FR_search(ANNdist);		// fixed-radius search
 };
 
@@ -30,6 +30,10 @@
 #include <stdlib.h>
 #include <math.h>
 #include <float.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "smooth_contours.h"
 
 /*----------------------------------------------------------------------------*/
 #ifndef FALSE
@@ -177,21 +181,35 @@ static void gaussian_kernel(double * kernel, int n, double sigma, double mean)
   if( sum > 0.0 ) for(i=0; i<n; i++) kernel[i] /= sum;
 }
 
+/*----------------------------------------------------------------------------*/
+/* index in [0,n) of the coordinate j extended by the symmetry boundary
+   condition, n2 = 2*n
+ */
+static int symmetric_index(int j, int n, int n2)
+{
+  while(j<0) j += n2;
+  while(j>=n2) j -= n2;
+  if( j >= n ) j = n2-1-j;
+  return j;
+}
+
 /*----------------------------------------------------------------------------*/
 /* filter an image with a Gaussian kernel of parameter sigma. return a pointer
    to a newly allocated filtered image, of the same size as the input image.
  */
-static double * gaussian_filter(double * image, int X, int Y, double sigma)
+static double * gaussian_filter(double * image, int X, int Y, double sigma,
+                                int threads)
 {
-  int x,y,offset,i,j,nx2,ny2,n;
+  int x,y,offset,i,nx2,ny2,n;
   double * kernel;
   double * tmp;
   double * out;
-  double val,prec;
+  double prec;
 
   /* check input */
   if( sigma <= 0.0 ) error("gaussian_filter: sigma must be positive");
   if( image == NULL || X < 1 || Y < 1 ) error("gaussian_filter: invalid image");
+  if( threads < 1 ) error("gaussian_filter: invalid number of threads");
 
   /* get memory */
   tmp = (double *) xmalloc( X * Y * sizeof(double) );
@@ -216,43 +234,46 @@ static double * gaussian_filter(double * image, int X, int Y, double sigma)
   nx2 = 2*X;
   ny2 = 2*Y;
 
-  /* x axis convolution */
-  for(x=0; x<X; x++)
-    for(y=0; y<Y; y++)
-      {
-        val = 0.0;
-        for(i=0; i<n; i++)
-          {
-            j = x - offset + i;
+  /* x axis convolution. each row is first extended by the symmetry boundary
+     condition, so that the inner loop runs over contiguous pixels and
+     vectorizes. the terms of each pixel are still added in kernel order,
+     the result is identical to the pixel by pixel convolution.
+     rows are independent and filtered in parallel */
+#pragma omp parallel for private(x,i) num_threads(threads)
+  for(y=0; y<Y; y++)
+    {
+      double * row = (double *) xmalloc( (X + n - 1) * sizeof(double) );
+      double * out_row = tmp + y*X;
 
-            /* symmetry boundary condition */
-            while(j<0) j += nx2;
-            while(j>=nx2) j -= nx2;
-            if( j >= X ) j = nx2-1-j;
+      for(x=0; x<X+n-1; x++)
+        row[x] = image[ symmetric_index(x - offset, X, nx2) + y*X ];
 
-            val += image[j+y*X] * kernel[i];
-          }
-        tmp[x+y*X] = val;
-      }
+      for(x=0; x<X; x++) out_row[x] = 0.0;
+      for(i=0; i<n; i++)
+        {
+          double k = kernel[i];
+          double * in = row + i;
+          for(x=0; x<X; x++) out_row[x] += in[x] * k;
+        }
 
-  /* y axis convolution */
-  for(x=0; x<X; x++)
-    for(y=0; y<Y; y++)
-      {
-        val = 0.0;
-        for(i=0; i<n; i++)
-          {
-            j = y - offset + i;
+      free( (void *) row );
+    }
 
-            /* symmetry boundary condition */
-            while(j<0) j += ny2;
-            while(j>=ny2) j -= ny2;
-            if( j >= Y ) j = ny2-1-j;
+  /* y axis convolution, row by row: each output row is a combination of
+     input rows, again added in kernel order */
+#pragma omp parallel for private(x,i) num_threads(threads)
+  for(y=0; y<Y; y++)
+    {
+      double * out_row = out + y*X;
 
-            val += tmp[x+j*X] * kernel[i];
-          }
-        out[x+y*X] = val;
-      }
+      for(x=0; x<X; x++) out_row[x] = 0.0;
+      for(i=0; i<n; i++)
+        {
+          double k = kernel[i];
+          double * in = tmp + symmetric_index(y - offset + i, Y, ny2) * X;
+          for(x=0; x<X; x++) out_row[x] += in[x] * k;
+        }
+    }
 
   /* free memory */
   free( (void *) kernel );
@@ -337,17 +358,19 @@ static double chain( int from, int to, double * Ex, double * Ey,
    modulus. Gx, Gy, and modG must be already allocated.
  */
 static void compute_gradient( double * Gx, double * Gy, double * modG,
-                              double * image, int X, int Y )
+                              double * image, int X, int Y, int threads )
 {
   int x,y;
 
   /* check input */
-  if( Gx == NULL || Gy == NULL || modG == NULL || image == NULL )
+  if( Gx == NULL || Gy == NULL || modG == NULL || image == NULL || threads < 1 )
     error("compute_gradient: invalid input");
 
-  /* approximate image gradient using centered differences */
-  for(x=1; x<(X-1); x++)
-    for(y=1; y<(Y-1); y++)
+  /* approximate image gradient using centered differences,
+     row by row so that the inner loop runs over contiguous pixels */
+#pragma omp parallel for private(x) num_threads(threads)
+  for(y=1; y<(Y-1); y++)
+    for(x=1; x<(X-1); x++)
       {
         Gx[x+y*X]   = image[(x+1)+y*X] - image[(x-1)+y*X];
         Gy[x+y*X]   = image[x+(y+1)*X] - image[x+(y-1)*X];
@@ -425,20 +448,24 @@ static void compute_gradient( double * Gx, double * Gy, double * modG,
    well enough. this is done in the function chain_edge_points() below.
  */
 static void compute_edge_points( double * Ex, double * Ey, double * modG,
-                                 double * Gx, double * Gy, int X, int Y )
+                                 double * Gx, double * Gy, int X, int Y,
+                                 int threads )
 {
   int x,y,i;
 
   /* check input */
-  if( Ex == NULL || Ey == NULL || modG == NULL || Gx == NULL || Gy == NULL )
+  if( Ex == NULL || Ey == NULL || modG == NULL || Gx == NULL || Gy == NULL
+      || threads < 1 )
     error("compute_edge_points: invalid input");
 
   /* initialize Ex and Ey as non edge points for all pixels */
   for(i=0; i<X*Y; i++) Ex[i] = Ey[i] = -1.0;
 
-  /* explore pixels inside a 2 pixel margin (so modG[x,y +/- 1,1] is defined) */
-  for(x=2; x<(X-2); x++)
-    for(y=2; y<(Y-2); y++)
+  /* explore pixels inside a 2 pixel margin (so modG[x,y +/- 1,1] is defined).
+     each pixel only writes its own edge point: rows are explored in parallel */
+#pragma omp parallel for private(x) num_threads(threads)
+  for(y=2; y<(Y-2); y++)
+    for(x=2; x<(X-2); x++)
       {
         int Dx = 0;                     /* interpolation will be along Dx,Dy, */
         int Dy = 0;                     /*   which will be selected below     */
@@ -852,7 +879,8 @@ static void list_chained_edge_points( double ** x, double ** y, int * N,
  */
 static void chained_subpixel_edge_points( double ** x, double ** y, int * N,
                                           int ** curve_limits, int * M,
-                                          double * image, int X, int Y )
+                                          double * image, int X, int Y,
+                                          int threads )
 {
   double * Gx   = (double *) xmalloc( X * Y * sizeof(double) );     /* grad_x */
   double * Gy   = (double *) xmalloc( X * Y * sizeof(double) );     /* grad_y */
@@ -862,9 +890,9 @@ static void chained_subpixel_edge_points( double ** x, double ** y, int * N,
   int * next = (int *) xmalloc( X * Y * sizeof(int) ); /* next point in chain */
   int * prev = (int *) xmalloc( X * Y * sizeof(int) ); /* prev point in chain */
 
-  compute_gradient(Gx,Gy,modG,image,X,Y);
+  compute_gradient(Gx,Gy,modG,image,X,Y,threads);
 
-  compute_edge_points(Ex,Ey,modG,Gx,Gy,X,Y);
+  compute_edge_points(Ex,Ey,modG,Gx,Gy,X,Y,threads);
 
   chain_edge_points(next,prev,Ex,Ey,Gx,Gy,X,Y);
 
@@ -1462,6 +1490,18 @@ static int compute_min_length(int X, int Y, double max_w, int W, double log_eps)
 void smooth_contours( double ** x, double ** y, int * N,
                       int ** curve_limits, int * M,
                       double * image, int X, int Y, double Q )
+{
+  smooth_contours_threads(x,y,N,curve_limits,M,image,X,Y,Q,0);
+}
+
+/*----------------------------------------------------------------------------*/
+/* Smooth Contours, with the filtering and edge point loops run by 'threads'
+   OpenMP threads; 0 uses the OpenMP default team size.
+ */
+void smooth_contours_threads( double ** x, double ** y, int * N,
+                              int ** curve_limits, int * M,
+                              double * image, int X, int Y, double Q,
+                              int threads )
 {
   double dog_rate = 1.6;    /* DoG sigma rate to approx. Laplacian of Gaussian
                                optimal value 1.6 [Marr-Hildreth 1980] */
@@ -1489,15 +1529,24 @@ void smooth_contours( double ** x, double ** y, int * N,
   int i,k,n,reg_n,c,NN,MM,min_l;
   double w;
 
+  /* team size of the parallel loops */
+  if( threads < 0 ) error("smooth_contours: invalid number of threads");
+#ifdef _OPENMP
+  if( threads == 0 ) threads = omp_get_max_threads();
+#else
+  threads = 1;
+#endif
+
   /* compute minimal arc length that may become meaningful */
   min_l = compute_min_length(X,Y,max_w,W,log_eps);
 
   /* filter the input image by a Gaussian filter and compute difference image */
-  gauss = gaussian_filter(image, X, Y, sigma);
+  gauss = gaussian_filter(image, X, Y, sigma, threads);
   for(n=0; n<X*Y; n++) diff[n] = image[n] - gauss[n];
 
   /* compute chained edge points */
-  chained_subpixel_edge_points(&xx, &yy, &NN, &curve, &MM, gauss, X, Y);
+  chained_subpixel_edge_points(&xx, &yy, &NN, &curve, &MM, gauss, X, Y,
+                               threads);
 
   /* initialize all edge points as not meaningful and not used */
   for(n=0; n<NN; n++) meaningful[n] = used[n] = FALSE;
@@ -72,5 +72,14 @@ void smooth_contours( double ** x, double ** y, int * N,
                       int ** curve_limits, int * M,
                       double * image, int X, int Y, double Q );
 
+/* the same, with the filtering and edge point loops run by 'threads' OpenMP
+   threads: 0 for the OpenMP default team, 1 to run serially, for instance
+   when it is already called from several threads.
+ */
+void smooth_contours_threads( double ** x, double ** y, int * N,
+                              int ** curve_limits, int * M,
+                              double * image, int X, int Y, double Q,
+                              int threads );
+
 #endif /* !SMOOTH_CONTOURS_HEADER */
 /*----------------------------------------------------------------------------*/
@@ -804,13 +804,13 @@ void Viewer::loadWarpGrid(string filename)
 
 void Viewer::loadWarpGridOnGPU()
 {
-	vector<float> warpdata;
+	const float* warpdata = nullptr;
 	size_t nvertices = 0;
 	GLuint current_glID = -1;
 
 	if (warp_map->isLoaded())
 	{
-		warpdata = warp_map->getPointDataConstRef();
+		warpdata = warp_map->getPointData();
 		nvertices = warp_map->getNumberOfVertices();
 
 		if (glIsTexture(pbrTextureGLIndex[warpgrid_layout]))
@@ -836,7 +836,7 @@ void Viewer::loadWarpGridOnGPU()
 	// load and generate the texture
 	GLsizei width = int(sqrt(nvertices)), height = int(sqrt(nvertices));
 	glTextureStorage2D(current_glID, 1, GL_RG32F, width, height);
-	glTextureSubImage2D(current_glID, 0, 0, 0, width, height, GL_RG, GL_FLOAT, warpdata.data());
+	glTextureSubImage2D(current_glID, 0, 0, 0, width, height, GL_RG, GL_FLOAT, warpdata);
 }
 
 void Viewer::computeNormalFromHeight(int mat_id, const string& mat_path)
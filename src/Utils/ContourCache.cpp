@@ -0,0 +1,149 @@
+#include "ContourCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <thread>
+
+static const char contour_cache_magic[4] = { 'M', 'M', 'C', 'C' };
+static const uint32_t contour_cache_version = 2;
+
+static const uint64_t fnv_offset = 14695981039346656037ull;
+static const uint64_t fnv_prime = 1099511628211ull;
+
+static inline void fnv1a(uint64_t& hash, void const* data, size_t size)
+{
+	unsigned char const* bytes = static_cast<unsigned char const*>(data);
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= fnv_prime;
+	}
+}
+
+bool contour_cache_key(std::string const& filename, int map_id, int resolution, double Q, bool flip_vertically, uint64_t& key)
+{
+	std::ifstream file(filename, std::ios::binary);
+	if (!file)
+		return false;
+
+	key = fnv_offset;
+	std::vector<char> buffer(1 << 20);
+	while (file)
+	{
+		file.read(buffer.data(), buffer.size());
+		fnv1a(key, buffer.data(), size_t(file.gcount()));
+	}
+
+	// the parameters of the extraction, and the version of the format so that a new one misses the old files
+	fnv1a(key, &contour_cache_version, sizeof(contour_cache_version));
+	fnv1a(key, &map_id, sizeof(map_id));
+	fnv1a(key, &resolution, sizeof(resolution));
+	fnv1a(key, &Q, sizeof(Q));
+	fnv1a(key, &flip_vertically, sizeof(flip_vertically));
+	return true;
+}
+
+std::string contour_cache_path(std::string const& cache_dir, uint64_t key)
+{
+	std::ostringstream name;
+	name << std::hex << std::setw(16) << std::setfill('0') << key << ".contours";
+	return (std::filesystem::path(cache_dir) / name.str()).string();
+}
+
+bool load_contour_cache(std::string const& cache_dir, uint64_t key, size_t& X, size_t& Y, contourCurves& curves)
+{
+	FILE* file = fopen(contour_cache_path(cache_dir, key).c_str(), "rb");
+	if (file == NULL)
+		return false;
+
+	char magic[4];
+	uint32_t version = 0, size[2] = { 0, 0 };
+	uint64_t fileKey = 0;
+	int32_t N = 0, M = 0;
+	bool ok = fread(magic, 1, 4, file) == 4 && memcmp(magic, contour_cache_magic, 4) == 0
+		&& fread(&version, sizeof(version), 1, file) == 1 && version == contour_cache_version
+		&& fread(&fileKey, sizeof(fileKey), 1, file) == 1 && fileKey == key
+		&& fread(size, sizeof(uint32_t), 2, file) == 2
+		&& fread(&N, sizeof(N), 1, file) == 1 && fread(&M, sizeof(M), 1, file) == 1
+		&& N >= 0 && M >= 0;
+
+	// the arrays must fit in the rest of the file before they are allocated
+	if (ok)
+	{
+		long header = ftell(file);
+		ok = fseek(file, 0, SEEK_END) == 0
+			&& uint64_t(ftell(file) - header) == (uint64_t(M) + 1) * sizeof(int32_t) + uint64_t(N) * 2 * sizeof(double)
+			&& fseek(file, header, SEEK_SET) == 0;
+	}
+
+	if (ok)
+	{
+		curves.curve_limits.resize(size_t(M) + 1);
+		curves.x.resize(N);
+		curves.y.resize(N);
+		std::vector<int32_t> limits(size_t(M) + 1);
+		ok = fread(limits.data(), sizeof(int32_t), limits.size(), file) == limits.size()
+			&& fread(curves.x.data(), sizeof(double), N, file) == size_t(N)
+			&& fread(curves.y.data(), sizeof(double), N, file) == size_t(N)
+			&& limits[0] == 0 && limits[M] == N && std::is_sorted(limits.begin(), limits.end());
+		std::copy(limits.begin(), limits.end(), curves.curve_limits.begin());
+	}
+	fclose(file);
+
+	if (!ok)
+	{
+		std::cout << "ignoring invalid contour cache file " << contour_cache_path(cache_dir, key) << std::endl;
+		curves = contourCurves();
+		return false;
+	}
+
+	X = size[0];
+	Y = size[1];
+	return true;
+}
+
+bool save_contour_cache(std::string const& cache_dir, uint64_t key, size_t X, size_t Y, contourCurves const& curves)
+{
+	std::error_code error;
+	std::filesystem::create_directories(cache_dir, error);
+
+	std::string path = contour_cache_path(cache_dir, key);
+	std::ostringstream aside;
+	aside << path << "." << std::hash<std::thread::id>()(std::this_thread::get_id()) << ".tmp";
+
+	FILE* file = fopen(aside.str().c_str(), "wb");
+	if (file == NULL)
+	{
+		std::cout << "cannot write contour cache file " << aside.str() << std::endl;
+		return false;
+	}
+
+	uint32_t size[2] = { uint32_t(X), uint32_t(Y) };
+	int32_t N = curves.points(), M = curves.curves();
+	std::vector<int32_t> limits(curves.curve_limits.begin(), curves.curve_limits.end());
+	bool ok = fwrite(contour_cache_magic, 1, 4, file) == 4
+		&& fwrite(&contour_cache_version, sizeof(contour_cache_version), 1, file) == 1
+		&& fwrite(&key, sizeof(key), 1, file) == 1
+		&& fwrite(size, sizeof(uint32_t), 2, file) == 2
+		&& fwrite(&N, sizeof(N), 1, file) == 1 && fwrite(&M, sizeof(M), 1, file) == 1
+		&& fwrite(limits.data(), sizeof(int32_t), limits.size(), file) == limits.size()
+		&& fwrite(curves.x.data(), sizeof(double), N, file) == size_t(N)
+		&& fwrite(curves.y.data(), sizeof(double), N, file) == size_t(N);
+	ok = (fclose(file) == 0) && ok;
+
+	if (ok)
+		std::filesystem::rename(aside.str(), path, error);
+	if (!ok || error)
+	{
+		std::cout << "cannot write contour cache file " << path << std::endl;
+		std::filesystem::remove(aside.str(), error);
+		return false;
+	}
+	return true;
+}
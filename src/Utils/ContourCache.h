@@ -0,0 +1,28 @@
+#pragma once
+
+#include "Utils/ContourTiles.h"
+
+#include <string>
+#include <cstdint>
+
+// On-disk cache of the contour curves of a map, so that a map is extracted only once across runs.
+//
+// A cache file is named after a 64 bit FNV-1a hash of the bytes of the map file and of the extraction
+// parameters (map id, resolution, Q, vertical flip), so that an edited map or other parameters miss
+// the cache rather than reading stale curves. It holds the size of the image the curves were extracted from and the
+// curves in binary, in the layout of contourCurves:
+//   "MMCC" | version | key | X Y | N M | curve_limits[M+1] (int32) | x[N] y[N] (float64)
+// in the byte order of the machine.
+
+// key of the map file with the extraction parameters, false if the file cannot be read
+bool contour_cache_key(std::string const& filename, int map_id, int resolution, double Q, bool flip_vertically, uint64_t& key);
+
+// path of the cache file of the key in the cache directory
+std::string contour_cache_path(std::string const& cache_dir, uint64_t key);
+
+// reads the cached curves of the key and the size of their image, false if missing or invalid
+bool load_contour_cache(std::string const& cache_dir, uint64_t key, size_t& X, size_t& Y, contourCurves& curves);
+
+// writes the curves of the key, creating the cache directory if needed. The file is written
+// aside and renamed, so that a concurrent or interrupted run never reads a partial file
+bool save_contour_cache(std::string const& cache_dir, uint64_t key, size_t X, size_t Y, contourCurves const& curves);
@@ -0,0 +1,272 @@
+#include "ContourTiles.h"
+
+extern "C"
+{
+#include "smooth_contours.h"
+}
+
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <unordered_map>
+
+// a piece of a curve inside a tile
+struct curveFragment
+{
+	std::vector<double> x, y;
+	bool cut[2] = { false, false };		// the curve continues out of the tile before the first / after the last point
+};
+
+// largest distance in pixels between the two sides of a curve cut by a tile border
+static const double stitch_radius = 2.5;
+
+static inline int wrap_index(int i, int n)
+{
+	return ((i % n) + n) % n;
+}
+
+// d wrapped into [-n/2, n/2]
+static inline double wrap_delta(double d, double n)
+{
+	return d - n * std::floor(d / n + 0.5);
+}
+
+// appends the curves found by smooth_contours in the image, filtered by nthreads OpenMP threads
+static void append_smooth_contours(double* image, int X, int Y, double Q, contourCurves& curves, unsigned int nthreads)
+{
+	double* x;			/* x[n] coordinates of result contour point n */
+	double* y;			/* y[n] coordinates of result contour point n */
+	int* curve_limits;	/* limits of the curves in x[] and y[] */
+	int N, M;			/* result: N contour points, forming M curves */
+
+	smooth_contours_threads(&x, &y, &N, &curve_limits, &M, image, X, Y, Q, int(nthreads));
+
+	int offset = curves.points();
+	curves.x.insert(curves.x.end(), x, x + N);
+	curves.y.insert(curves.y.end(), y, y + N);
+	for (int k = 1; k <= M; k++)
+		curves.curve_limits.push_back(offset + curve_limits[k]);
+
+	free((void*)curve_limits);
+	free((void*)x);
+	free((void*)y);
+}
+
+// extracts the tile [x0,x0+w)*[y0,y0+h) of the image with its margin, and clips its curves to the tile
+static void extract_tile(std::vector<float> const& image, int X, int Y, double Q,
+	int x0, int y0, int w, int h, int overlap, unsigned int nthreads, std::vector<curveFragment>& fragments)
+{
+	int PX = w + 2 * overlap, PY = h + 2 * overlap;
+	std::vector<double> tile(size_t(PX) * PY);
+	for (int py = 0; py < PY; py++)
+	{
+		int gy = wrap_index(y0 - overlap + py, Y);
+		for (int px = 0; px < PX; px++)
+			tile[px + size_t(py) * PX] = image[wrap_index(x0 - overlap + px, X) + size_t(gy) * X];
+	}
+
+	contourCurves local;
+	append_smooth_contours(tile.data(), PX, PY, Q, local, nthreads);
+
+	for (int k = 0; k < local.curves(); k++)
+	{
+		int begin = local.curve_limits[k], end = local.curve_limits[k + 1];
+		bool closed = end - begin > 1 && local.x[begin] == local.x[end - 1] && local.y[begin] == local.y[end - 1];
+		size_t first = fragments.size();
+
+		// runs of consecutive points inside the tile
+		bool inside = false;
+		for (int i = begin; i < end; i++)
+		{
+			double gx = local.x[i] + x0 - overlap, gy = local.y[i] + y0 - overlap;
+			bool in = gx >= x0 && gx < x0 + w && gy >= y0 && gy < y0 + h;
+			if (in && !inside)
+			{
+				fragments.push_back(curveFragment());
+				fragments.back().cut[0] = (i != begin);
+			}
+			else if (!in && inside)
+			{
+				fragments.back().cut[1] = true;
+			}
+			if (in)
+			{
+				fragments.back().x.push_back(gx);
+				fragments.back().y.push_back(gy);
+			}
+			inside = in;
+		}
+
+		// a closed curve that leaves the tile: its last run continues into its first one
+		size_t count = fragments.size() - first;
+		if (closed && count > 1 && !fragments[first].cut[0] && !fragments.back().cut[1])
+		{
+			curveFragment& last = fragments.back();
+			curveFragment& head = fragments[first];
+			last.x.insert(last.x.end(), head.x.begin() + 1, head.x.end());
+			last.y.insert(last.y.end(), head.y.begin() + 1, head.y.end());
+			last.cut[1] = head.cut[1];
+			head = last;
+			fragments.pop_back();
+		}
+	}
+}
+
+void smooth_contours_tiled(std::vector<float> const& image, int X, int Y, double Q, contourCurves& curves,
+	int tileSize, int overlap, unsigned int nthreads)
+{
+	curves = contourCurves();
+
+	if (X <= tileSize && Y <= tileSize)
+	{
+		std::vector<double> copy(image.begin(), image.end());
+		append_smooth_contours(copy.data(), X, Y, Q, curves, std::max(1u, nthreads));
+		return;
+	}
+
+	// the tiles are extracted in parallel, and their fragments merged in tile order. The threads
+	// left over by the tiles filter each tile, so that nthreads bounds the threads of the extraction
+	int TX = (X + tileSize - 1) / tileSize, TY = (Y + tileSize - 1) / tileSize;
+	overlap = std::min(overlap, std::min(X, Y));
+	std::vector<std::vector<curveFragment>> tileFragments(size_t(TX) * TY);
+	unsigned int filter_threads = std::max(1u, nthreads / (unsigned int)tileFragments.size());
+	parallel_for(0, tileFragments.size(), [&](size_t begin, size_t end) {
+		for (size_t t = begin; t < end; t++)
+		{
+			int x0 = int(t % TX) * tileSize, y0 = int(t / TX) * tileSize;
+			extract_tile(image, X, Y, Q, x0, y0, std::min(tileSize, X - x0), std::min(tileSize, Y - y0), overlap, filter_threads, tileFragments[t]);
+		}
+	}, 1, nthreads);
+
+	std::vector<curveFragment> fragments;
+	std::vector<size_t> fragmentTile;
+	for (size_t t = 0; t < tileFragments.size(); t++)
+	{
+		for (curveFragment& f : tileFragments[t])
+		{
+			fragments.push_back(std::move(f));
+			fragmentTile.push_back(t);
+		}
+	}
+
+	// cut ends, endpoint e is the side e%2 of the fragment e/2, bucketed in cells of the stitch radius
+	auto endpoint = [&](size_t e, double& x, double& y) {
+		curveFragment const& f = fragments[e / 2];
+		size_t i = (e % 2 == 0) ? 0 : f.x.size() - 1;
+		x = f.x[i];
+		y = f.y[i];
+	};
+	int GX = std::max(1, int(X / stitch_radius)), GY = std::max(1, int(Y / stitch_radius));
+	auto cellOf = [&](double x, double y) {
+		return std::make_pair(std::min(int(x * GX / X), GX - 1), std::min(int(y * GY / Y), GY - 1));
+	};
+	std::unordered_map<long long, std::vector<size_t>> cells;
+	for (size_t e = 0; e < 2 * fragments.size(); e++)
+	{
+		if (!fragments[e / 2].cut[e % 2]) continue;
+		double x, y;
+		endpoint(e, x, y);
+		std::pair<int, int> c = cellOf(x, y);
+		cells[(long long)c.second * GX + c.first].push_back(e);
+	}
+
+	// candidate pairs of cut ends of different tiles, across the texture edges too. The ends of a tile
+	// can only be stitched across a texture edge, when the image is a single tile wide or tall
+	struct stitch { double d; size_t a, b; };
+	std::vector<stitch> stitches;
+	for (auto const& cell : cells)
+	{
+		int cx = int(cell.first % GX), cy = int(cell.first / GX);
+		for (size_t a : cell.second)
+		{
+			double ax, ay;
+			endpoint(a, ax, ay);
+			for (int dy = -1; dy <= 1; dy++)
+			{
+				for (int dx = -1; dx <= 1; dx++)
+				{
+					auto neighbor = cells.find((long long)wrap_index(cy + dy, GY) * GX + wrap_index(cx + dx, GX));
+					if (neighbor == cells.end()) continue;
+					for (size_t b : neighbor->second)
+					{
+						if (b <= a) continue;
+						double bx, by;
+						endpoint(b, bx, by);
+						double wx = wrap_delta(ax - bx, X), wy = wrap_delta(ay - by, Y);
+						if (fragmentTile[a / 2] == fragmentTile[b / 2] && wx == ax - bx && wy == ay - by) continue;
+						double d = std::hypot(wx, wy);
+						if (d < stitch_radius)
+							stitches.push_back({ d, a, b });
+					}
+				}
+			}
+		}
+	}
+
+	// closest pairs first, each end is stitched once
+	std::sort(stitches.begin(), stitches.end(), [](stitch const& s, stitch const& t) {
+		return s.d < t.d || (s.d == t.d && (s.a < t.a || (s.a == t.a && s.b < t.b)));
+	});
+	std::vector<long long> link(2 * fragments.size(), -1);
+	for (stitch const& s : stitches)
+	{
+		if (link[s.a] >= 0 || link[s.b] >= 0) continue;
+		link[s.a] = (long long)s.b;
+		link[s.b] = (long long)s.a;
+	}
+
+	// chains of fragments, entered from side s and left from the other side. Each fragment is shifted
+	// by whole texture sizes to continue its predecessor across the texture edges
+	std::vector<bool> visited(fragments.size(), false);
+	auto emitChain = [&](size_t f, int s) {
+		int start = curves.points();
+		size_t first = f;
+		while (true)
+		{
+			visited[f] = true;
+			curveFragment const& frag = fragments[f];
+			size_t n = frag.x.size();
+			double ox = 0.0, oy = 0.0;
+			if (curves.points() > start)
+			{
+				size_t i = (s == 0) ? 0 : n - 1;
+				ox = curves.x.back() - wrap_delta(curves.x.back() - frag.x[i], X) - frag.x[i];
+				oy = curves.y.back() - wrap_delta(curves.y.back() - frag.y[i], Y) - frag.y[i];
+			}
+			for (size_t j = 0; j < n; j++)
+			{
+				size_t i = (s == 0) ? j : n - 1 - j;
+				curves.x.push_back(frag.x[i] + ox);
+				curves.y.push_back(frag.y[i] + oy);
+			}
+
+			long long next = link[2 * f + (1 - s)];
+			if (next < 0)
+				break;
+			f = size_t(next) / 2;
+			s = int(next % 2);
+			if (visited[f])
+			{
+				// back to the first fragment: close the curve, unless it went around the torus
+				if (f == first && std::hypot(curves.x.back() - curves.x[start], curves.y.back() - curves.y[start]) < stitch_radius)
+				{
+					curves.x.push_back(curves.x[start]);
+					curves.y.push_back(curves.y[start]);
+				}
+				break;
+			}
+		}
+		curves.curve_limits.push_back(curves.points());
+	};
+
+	// open chains from their free ends, then the closed ones
+	for (size_t f = 0; f < fragments.size(); f++)
+	{
+		if (visited[f]) continue;
+		if (link[2 * f] < 0) emitChain(f, 0);
+		else if (link[2 * f + 1] < 0) emitChain(f, 1);
+	}
+	for (size_t f = 0; f < fragments.size(); f++)
+		if (!visited[f])
+			emitChain(f, 0);
+}
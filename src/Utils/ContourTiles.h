@@ -0,0 +1,34 @@
+#pragma once
+
+#include "Utils/Parallel.h"
+
+#include <vector>
+
+// contour curves of an image in pixel coordinates, in the layout of smooth_contours:
+// curve k is made of the points [ curve_limits[k] , curve_limits[k+1] ), and is closed
+// when its first and last points are equal
+struct contourCurves
+{
+	std::vector<double> x, y;
+	std::vector<int> curve_limits = std::vector<int>(1, 0);
+
+	int points() const { return int(x.size()); }
+	int curves() const { return int(curve_limits.size()) - 1; }
+};
+
+// smooth_contours of the X*Y image (image[x + y*X]) for the pixel quantization step Q.
+//
+// At most nthreads threads run the extraction, the tiles and the OpenMP loops of smooth_contours together:
+// called from several threads, each call gets its share of the threads.
+//
+// An image larger than tileSize is split in tiles of tileSize*tileSize pixels, extracted in parallel
+// with a margin of overlap pixels around them, wrapped around the texture edges.
+// The memory of smooth_contours, about a hundred bytes per pixel, is then bounded by the tile size.
+// The curves of each tile are clipped to the tile, and the pieces cut by the tile borders are stitched
+// back to their continuation in the neighbor tile, across the texture edges too: a curve crossing a
+// texture edge stays continuous, its points then lie slightly outside [0,X)*[0,Y).
+//
+// A smaller image is extracted in one piece, exactly as smooth_contours. Either way only the image of
+// a tile is converted to the double precision of smooth_contours.
+void smooth_contours_tiled(std::vector<float> const& image, int X, int Y, double Q, contourCurves& curves,
+	int tileSize = 1024, int overlap = 64, unsigned int nthreads = hardware_threads());
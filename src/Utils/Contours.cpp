@@ -1,7 +1,14 @@
 #include "Contours.h"
+#include "Utils/ContourTiles.h"
+#include "Utils/ContourCache.h"
 
-//#include "cySampleElim.h"
-//#include "cyPoint.h"
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <fstream>
+#include <filesystem>
 
 #include <QImage>
 #include <QPainter>
@@ -15,12 +22,31 @@ void* xmalloc(size_t size)
 	return p;
 }
 
+// 255 * the linear value of each 16 bit value of the color space, shared by all the reads
+static std::vector<float> const& ingest_lut(ColorSpace color_space)
+{
+	static const std::vector<float> srgb = [] {
+		std::vector<float> lut(65536);
+		for (size_t v = 0; v < lut.size(); v++)
+			lut[v] = float(255.0 * sRGB2Linear(v / 65535.0));
+		return lut;
+	}();
+	static const std::vector<float> linear = [] {
+		std::vector<float> lut(65536);
+		for (size_t v = 0; v < lut.size(); v++)
+			lut[v] = float(255.0 * v / 65535.0);
+		return lut;
+	}();
+	return color_space == ColorSpace::sRGB ? srgb : linear;
+}
+
 bool read_input_image(
-	std::vector<double>& out, 
+	std::vector<float>& out, 
 	std::string filename, 
-	size_t W, size_t H, 
+	size_t& W, size_t& H, 
 	ColorSpace color_space,
 	int map_id,
+	bool flip_vertically,
 	bool debug_out)
 {
 	int X, Y, channels;
@@ -44,101 +70,111 @@ bool read_input_image(
 		channels = 3;
 	}
 
-	if (image != NULL)
+	if (image == NULL)
+	{
+		std::cout << "could not load image" << filename << std::endl;
+		return false;
+	}
+
+	if (W == 0 || H == 0)
 	{
-		uint16_t* image_resized = (uint16_t*) xmalloc(H * W * channels * sizeof(uint16_t));
+		W = X;
+		H = Y;
+	}
 
-		if (image_resized == NULL) return false;
+	// a single pass over the rows of the decoded image linearizes them through the lookup table, converts
+	// them to gray and flips them: the gray image is written directly to out when it has the requested size,
+	// and only its single float channel is resampled otherwise. The flip is done here rather than by the
+	// global state of stb_image, so that images can be read concurrently
+	bool resize = (size_t(X) != W || size_t(Y) != H);
+	std::vector<float> gray;
+	std::vector<float>& target = resize ? gray : out;
+	target.resize(size_t(X) * Y);
+
+	std::vector<float> const& lut = ingest_lut(color_space);
+	float min = std::numeric_limits<float>::max();
+	float max = std::numeric_limits<float>::lowest();
+	for (int y = 0; y < Y; y++)
+	{
+		const uint16_t* row = image + size_t(y) * X * channels;
+		float* gray_row = target.data() + size_t(flip_vertically ? Y - 1 - y : y) * X;
 
-		if (X != W || Y != H)
+		// COLOR MAP: luma of the gamma corrected color
+		if (color_space == ColorSpace::sRGB)
 		{
-			if (stbir_resize_uint16_generic(
-				image,		   X, Y, 0,
-				image_resized, W, H, 0, 
-				channels, STBIR_ALPHA_CHANNEL_NONE, 0,
-				STBIR_EDGE_WRAP, STBIR_FILTER_TRIANGLE, 
-				static_cast<stbir_colorspace>(color_space), NULL) == 0)
+			for (int x = 0; x < X; x++)
 			{
-				cout << "failed to resample image " + filename << endl;
-				return false;
+				const uint16_t* pixel = row + size_t(x) * 3;
+				gray_row[x] = .299f * lut[pixel[0]] + .587f * lut[pixel[1]] + .114f * lut[pixel[2]];
 			}
 		}
-		else
+		// NORMAL MAP: z component
+		else if (channels == 3)
 		{
-			memcpy(image_resized, image, H * W * channels * sizeof(uint16_t));
+			for (int x = 0; x < X; x++)
+				gray_row[x] = lut[row[size_t(x) * 3 + 2]];
 		}
-
-		stbi_image_free(image);
-
-		out.clear();
-		out.resize(H * W);
-
-		for (size_t pos_2d = 0; pos_2d < H * W; pos_2d++)
+		else // channel == 1 --> greyscale
 		{
-			const uint16_t* pixelOffset = image_resized + pos_2d * static_cast<size_t>(channels);
-
-			double gray_value = 0;
-
-			// COLOR MAP
-			if (color_space == ColorSpace::sRGB)
-			{
-				// gamma corrected read
-				dvec3 rgb =
-				{
-					255.0 * sRGB2Linear(pixelOffset[0] / 65535.0),
-					255.0 * sRGB2Linear(pixelOffset[1] / 65535.0),
-					255.0 * sRGB2Linear(pixelOffset[2] / 65535.0)
-				};
-
-				gray_value = RGB2YCbCr(rgb).r;
-			}
-			// NORMAL MAP
-			else if (channels == 3)
-			{
-				gray_value = 255.0 * pixelOffset[2] / 65535.0;
-			}
-
-			else // channel == 1 --> greyscale
-			{
-				gray_value = 255.0 * pixelOffset[0] / 65535.0;
-			}
-
-			out[pos_2d] = gray_value;
+			for (int x = 0; x < X; x++)
+				gray_row[x] = lut[row[x]];
 		}
 
-		if (map_id == 1) // heightmap
+		// range of the heightmap, for its normalization
+		if (map_id == 1)
 		{
-			double min = 10e9;
-			double max = 0.0;
-			for (int i = 0; i < out.size(); i++)
+			for (int x = 0; x < X; x++)
 			{
-				if (out[i] < min) min = out[i];
-				else if (out[i] > max) max = out[i];
-			}
-			for (int i = 0; i < out.size(); i++)
-			{
-				out[i] = 255.0 * (out[i] - min) / (max - min);
+				min = std::min(min, gray_row[x]);
+				max = std::max(max, gray_row[x]);
 			}
 		}
+	}
+
+	stbi_image_free(image);
 
-		if (debug_out)
+	if (resize)
+	{
+		// the gray values are linear: the color map is resampled after its linearization
+		out.resize(W * H);
+		if (stbir_resize_float_generic(
+			gray.data(), X, Y, 0,
+			out.data(),	 W, H, 0,
+			1, STBIR_ALPHA_CHANNEL_NONE, 0,
+			STBIR_EDGE_WRAP, STBIR_FILTER_TRIANGLE,
+			STBIR_COLORSPACE_LINEAR, NULL) == 0)
 		{
-			if (stbi_write_png("clover/debug.png", W, H, channels, image_resized, 0) == 0)
-			{
-				cout << "failed to write image resized image" << endl;
-			}
+			cout << "failed to resample image " + filename << endl;
+			return false;
 		}
 
-		free((void*) image_resized);
+		if (map_id == 1)
+		{
+			auto range = std::minmax_element(out.begin(), out.end());
+			min = *range.first;
+			max = *range.second;
+		}
+	}
 
-		return true;
+	if (map_id == 1) // heightmap
+	{
+		float scale = (max > min) ? 255.0f / (max - min) : 0.0f;
+		for (float& value : out)
+			value = scale * (value - min);
 	}
 
-	else
+	if (debug_out)
 	{
-		std::cout << "could not load image" << filename << std::endl;
-		return false;
+		std::vector<unsigned char> gray_out(out.size());
+		for (size_t i = 0; i < out.size(); i++)
+			gray_out[i] = (unsigned char)std::min(std::max(out[i], 0.0f), 255.0f);
+		if (stbi_write_png("clover/debug.png", W, H, 1, gray_out.data(), 0) == 0)
+		{
+			cout << "failed to write image resized image" << endl;
+		}
 	}
+
+	return true;
 }
 
 void write_render_normal(std::string filename, std::string file_out)
@@ -146,6 +182,11 @@ void write_render_normal(std::string filename, std::string file_out)
 	int X, Y, channels;
 
 	uint16_t* image = stbi_load_16(filename.c_str(), &X, &Y, &channels, 0);
+	if (image == NULL)
+	{
+		cout << "could not load image" << filename << endl;
+		return;
+	}
 
 	if (channels != 3)
 		cout << "warning: normal map channels != 3" << endl;
@@ -163,11 +204,43 @@ void write_render_normal(std::string filename, std::string file_out)
 	{
 		cout << "failed to write image: " << filename << endl;
 	}
+
+	stbi_image_free(image);
+}
+
+// writes the curves as drawn by saveContourImage to basename.png, or with the writers of PolylineOutput.h
+static void save_contours(VisualOutput output, std::string basename,
+	double* x, double* y, int* curve_limits, int M, int X, int Y, double width)
+{
+	if (output == VisualOutput::Raster)
+	{
+		basename += ".png";
+		saveContourImage(x, y, curve_limits, M, &basename[0], X, Y, width);
+		return;
+	}
+
+	// saveContourImage draws y downwards
+	contourCurves curves;
+	curves.x.assign(x, x + curve_limits[M]);
+	curves.y.resize(curve_limits[M]);
+	for (int i = 0; i < curve_limits[M]; i++)
+		curves.y[i] = Y - y[i];
+	curves.curve_limits.assign(curve_limits, curve_limits + M + 1);
+	save_polylines(output, basename, curves, X, Y, { 0, 0, 0 }, width);
 }
 
-bool getContoursListFromMaps(std::string mat_name, int material_to_use, std::vector<vec2>& contourPts)
+// contour curves of one map, in pixels of its X*Y image
+struct mapContours
+{
+	bool read = false;
+	bool cached = false;
+	size_t X = 0, Y = 0;
+	contourCurves curves;
+};
+
+bool getContoursListFromMaps(std::string mat_name, int material_to_use, std::vector<vec2>& contourPts,
+	int resolution, std::string const& cache_dir, VisualOutput image)
 {
-	int N, M;			/* result: N contour points, forming M curves */
 	double Q = 2.0;		/* default Q=2, here we assume a smaller pixel quantization than compressed natural images */
 	bool result = true;
 
@@ -192,68 +265,97 @@ bool getContoursListFromMaps(std::string mat_name, int material_to_use, std::vec
 		ColorSpace::Linear,
 		ColorSpace::Linear};
 
-	size_t X = 1024, Y = 1024;
-	std::vector<double> sc_input;
-
 	contourPts.clear();
 
+	std::vector<int> map_ids;
 	for (int map_id = 0; map_id < 5; map_id++)
 	{
 		if ( !(material_to_use & (1 << (4 - map_id))) ) continue;
+		map_ids.push_back(map_id);
+		cout << "using " << mat_name + "/" + PBR_maps[map_id] + ".png" << " to compute warpgrid" << endl;
+	}
 
-		std::string mat_filename = mat_name + "/" + PBR_maps[map_id] + ".png";
+	// the maps are independent: they are read and their contours extracted concurrently,
+	// then merged in map order so that the points do not depend on the scheduling.
+	// The threads left over by the maps extract the tiles of each map
+	std::vector<mapContours> maps(map_ids.size());
+	unsigned int tile_threads = std::max(1u, hardware_threads() / std::max<unsigned int>(1u, (unsigned int)maps.size()));
+	parallel_for(0, map_ids.size(), [&](size_t begin, size_t end) {
+		for (size_t m = begin; m < end; m++)
+		{
+			int map_id = map_ids[m];
+			std::string filename = mat_name + "/" + PBR_maps[map_id] + ".png";
+			uint64_t key = 0;
+			bool keyed = !cache_dir.empty() && contour_cache_key(filename, map_id, resolution, Q, true, key);
+			if (keyed && load_contour_cache(cache_dir, key, maps[m].X, maps[m].Y, maps[m].curves))
+			{
+				maps[m].read = maps[m].cached = true;
+				continue;
+			}
 
-		cout << "using " << mat_filename << " to compute warpgrid" << endl;
+			std::vector<float> sc_input;
+			maps[m].X = maps[m].Y = size_t(resolution);
+			if (!read_input_image(sc_input, filename, maps[m].X, maps[m].Y, PBR_colorspaces[map_id], map_id, true))
+				continue;
+			smooth_contours_tiled(sc_input, int(maps[m].X), int(maps[m].Y), Q, maps[m].curves, 1024, 64, tile_threads);
+			maps[m].read = true;
+			if (keyed)
+				save_contour_cache(cache_dir, key, maps[m].X, maps[m].Y, maps[m].curves);
+		}
+	}, 1);
 
-		stbi_set_flip_vertically_on_load(true);
+	// the merged contour image is drawn at the size of the first map
+	size_t X = 0, Y = 0;
+	for (mapContours const& map : maps)
+	{
+		if (map.read && X == 0)
+		{
+			X = map.X;
+			Y = map.Y;
+		}
+	}
 
-		if (read_input_image(sc_input, mat_filename, X, Y, PBR_colorspaces[map_id], map_id))
+	for (size_t m = 0; m < maps.size(); m++)
+	{
+		mapContours& map = maps[m];
+		if (!map.read)
 		{
-			double* contour_x;  /* x[n] coordinates of result contour point n */
-			double* contour_y;  /* y[n] coordinates of result contour point n */
-			int* curve_limits;  /* limits of the curves in the x[] and y[] */
+			cout << "could not read " + mat_name + "/" + PBR_maps[map_ids[m]] + ".png" << endl;
+			result = false;
+			continue;
+		}
+		if (map.cached)
+			cout << "read the contours of " + mat_name + "/" + PBR_maps[map_ids[m]] + ".png from the cache" << endl;
 
-			smooth_contours(&contour_x, &contour_y, &N, &curve_limits, &M, sc_input.data(), X, Y, Q);
-			
-			/* write curves */
-			for (int k = 0; k < M; k++) /* write curves */
+		double sx = double(X) / map.X, sy = double(Y) / map.Y;
+		for (int k = 0; k < map.curves.curves(); k++) /* write curves */
+		{
+			for (int i = map.curves.curve_limits[k]; i < map.curves.curve_limits[k + 1]; i++)
 			{
-				for (int i = curve_limits[k]; i < curve_limits[k + 1]; i++)
-				{
-					contour_x_total.push_back(contour_x[i]);
-					contour_y_total.push_back(Y - contour_y[i]);
+				double x = map.curves.x[i], y = map.curves.y[i];
 
-					//inputPoints.push_back(cy::Point2f(contour_x[i] / float(X), contour_y[i] / float(Y)));
-					contourPts.push_back(vec2(contour_x[i] / float(X), contour_y[i] / float(Y)));
-				}
+				contour_x_total.push_back(sx * x);
+				contour_y_total.push_back(Y - sy * y);
 
-				curve_limits_total.push_back(curve_limits[k] + N_total);
+				// the curves stitched across the texture edges are wrapped back into the texture
+				if (x < 0.0 || x >= map.X) x -= map.X * std::floor(x / map.X);
+				if (y < 0.0 || y >= map.Y) y -= map.Y * std::floor(y / map.Y);
+				contourPts.push_back(vec2(x / float(map.X), y / float(map.Y)));
 			}
 
-			M_total += M;
-			N_total += N;
-
-			/* free memory */
-			free((void*)curve_limits);
-			free((void*)contour_x);
-			free((void*)contour_y);
+			curve_limits_total.push_back(map.curves.curve_limits[k] + N_total);
 		}
-		else
-		{
-			cout << "could not read " + mat_filename << endl;
-			result = false;
-		}
-	}
 
-	stbi_set_flip_vertically_on_load(false);
-	
-	curve_limits_total.push_back(M_total);
+		M_total += map.curves.curves();
+		N_total += map.curves.points();
+	}
 
-	cout << "detected " << M << " contours with a total of " << N << " points" << endl;
+	curve_limits_total.push_back(N_total);
 
-	std::string contours_out = mat_name + "/warp_contours.png";
+	cout << "detected " << M_total << " contours with a total of " << N_total << " points" << endl;
 
-	saveContourImage(contour_x_total.data(), contour_y_total.data(), curve_limits_total.data(), M_total, &contours_out[0], X, Y, 2.0);
+	if (X > 0)
+		save_contours(image, mat_name + "/warp_contours", contour_x_total.data(), contour_y_total.data(), curve_limits_total.data(), M_total, X, Y, 2.0);
 
 	return result;
 }
@@ -323,20 +425,130 @@ void saveContourImage(
 	image.mirrored(false, true).save(QString::fromStdString(filename));
 }
 
+// the map files of the contours command, named as in the material folders
+static const std::vector<std::string> contour_maps = { "color", "height", "metallic", "normal", "roughness" };
+
+static bool has_material_maps(std::filesystem::path const& folder)
+{
+	for (std::string const& map : contour_maps)
+		if (std::filesystem::is_regular_file(folder / (map + ".png")))
+			return true;
+	return false;
+}
+
+// the material folders of the argument of the contours command: a material folder, a directory tree
+// searched for the folders holding maps, or a text file listing one folder per line (# for comments)
+static bool list_materials(std::string const& input, std::vector<std::string>& materials, bool& library)
+{
+	std::error_code error;
+	library = true;
+
+	if (std::filesystem::is_regular_file(input, error))
+	{
+		std::ifstream list(input);
+		std::string line;
+		while (std::getline(list, line))
+		{
+			line.erase(line.find_last_not_of(" \t\r") + 1);
+			if (!line.empty() && line[0] != '#')
+				materials.push_back(line);
+		}
+	}
+	else if (!std::filesystem::is_directory(input, error))
+	{
+		std::cerr << "no material folder, library or list named " << input << std::endl;
+		return false;
+	}
+	else if (has_material_maps(input))
+	{
+		materials.push_back(input);
+		library = false;
+	}
+	else
+	{
+		auto options = std::filesystem::directory_options::skip_permission_denied;
+		for (auto it = std::filesystem::recursive_directory_iterator(input, options, error);
+			it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+		{
+			if (error) break;
+			if (it->is_directory(error) && has_material_maps(it->path()))
+				materials.push_back(it->path().string());
+		}
+		std::sort(materials.begin(), materials.end());
+	}
+	return true;
+}
+
+// a (material, map) job of the contours command
+struct contourJob
+{
+	std::string material;
+	int map_id = 0;
+
+	// filled by the extraction
+	size_t X = 0, Y = 0;
+	int points = 0, curves = 0;
+	double seconds = 0.0;
+	std::string status = "failed";
+};
+
 int mainContour(int argc, char* argv[])
 {
-	int N, M;			/* result: N contour points, forming M curves */
 	double Q = 2.0;		/* default Q=2 */
 	double W = 1.3;		/* PDF line width 1.3 */
+	int resolution = 1024;
+	std::string cache_dir;
+	unsigned int workers = hardware_threads();
+	VisualOutput images = VisualOutput::None;
+	bool images_set = false;	/* by default, contour images for a single material only */
 
-	std::string mat_name = argv[2];
+	for (int i = 3; i < argc; i += 2)
+	{
+		std::string option = argv[i];
+		if (i + 1 >= argc)
+		{
+			std::cerr << "missing value for option " << option << std::endl;
+			return EXIT_FAILURE;
+		}
+		if (option == "-resolution")
+		{
+			resolution = std::stoi(argv[i + 1]);
+			if (resolution < 0)
+			{
+				std::cerr << "the -resolution must be positive, or 0 for the native size, got: " << argv[i + 1] << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+		else if (option == "-cache")
+		{
+			cache_dir = argv[i + 1];
+		}
+		else if (option == "-threads")
+		{
+			workers = std::max(1, std::stoi(argv[i + 1]));
+		}
+		else if (option == "-images")
+		{
+			if (!parse_visual_output(argv[i + 1], images))
+			{
+				std::cerr << "unknown contour image output: " << argv[i + 1] << std::endl;
+				return EXIT_FAILURE;
+			}
+			images_set = true;
+		}
+		else
+		{
+			std::cerr << "unknown option for command contours: " << option << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
 
-	std::vector<std::string> PBR_maps = {
-		"color", 
-		"height", 
-		"metallic", 
-		"normal", 
-		"roughness"};
+	std::vector<std::string> materials;
+	bool library;
+	if (!list_materials(argv[2], materials, library))
+		return EXIT_FAILURE;
+	if (!images_set)
+		images = library ? VisualOutput::None : VisualOutput::Raster;
 
 	std::vector<ColorSpace> PBR_colorspaces = {
 		ColorSpace::sRGB,
@@ -345,38 +557,95 @@ int mainContour(int argc, char* argv[])
 		ColorSpace::Linear,
 		ColorSpace::Linear};
 
-	size_t X = 1024, Y = 1024;
-	std::vector<double> sc_input;
-
-	write_render_normal(mat_name + "/normal.png", mat_name + "/normal_render.png");
-
-	for (int map_id = 0; map_id < 5; map_id++)
+	// one job per map, so that a library of materials with few maps still uses all the workers
+	std::vector<contourJob> jobs;
+	for (std::string const& material : materials)
 	{
-		std::string mat_filename	= mat_name + "/" + PBR_maps[map_id] + ".png";
-		std::string contour_out		= mat_name + "/acontrs_" + PBR_maps[map_id] + ".png";
-
-		if (read_input_image(sc_input, mat_filename, X, Y, PBR_colorspaces[map_id], map_id))
+		for (int map_id = 0; map_id < 5; map_id++)
 		{
-			double* contour_x;  /* x[n] coordinates of result contour point n */
-			double* contour_y;  /* y[n] coordinates of result contour point n */
-			int* curve_limits;  /* limits of the curves in the x[] and y[] */
+			if (!std::filesystem::is_regular_file(material + "/" + contour_maps[map_id] + ".png"))
+			{
+				if (!library)
+					cout << "no " << contour_maps[map_id] << " map in " << material << endl;
+				continue;
+			}
+			contourJob job;
+			job.material = material;
+			job.map_id = map_id;
+			jobs.push_back(job);
+		}
+	}
 
-			smooth_contours(&contour_x, &contour_y, &N, &curve_limits, &M, sc_input.data(), X, Y, Q);
+	cout << jobs.size() << " maps of " << materials.size() << " materials, extracted by " << workers << " workers" << endl;
+
+	// the jobs are handed out one at a time, the threads left over by the jobs extract the tiles of the maps
+	unsigned int tile_threads = std::max(1u, workers / std::max<unsigned int>(1u, (unsigned int)jobs.size()));
+	std::mutex log;
+	auto start = std::chrono::steady_clock::now();
+	parallel_for(0, jobs.size(), [&](size_t begin, size_t end) {
+		for (size_t j = begin; j < end; j++)
+		{
+			contourJob& job = jobs[j];
+			std::string mat_filename	= job.material + "/" + contour_maps[job.map_id] + ".png";
+			std::string contour_out		= job.material + "/acontrs_" + contour_maps[job.map_id];
+			auto jobStart = std::chrono::steady_clock::now();
+
+			if (images == VisualOutput::Raster && job.map_id == 3)
+				write_render_normal(mat_filename, job.material + "/normal_render.png");
+
+			job.X = job.Y = resolution;
+			contourCurves curves;
+			uint64_t key = 0;
+			bool keyed = !cache_dir.empty() && contour_cache_key(mat_filename, job.map_id, resolution, Q, false, key);
+			std::vector<float> sc_input;
+			if (keyed && load_contour_cache(cache_dir, key, job.X, job.Y, curves))
+			{
+				job.status = "cached";
+			}
+			else if (read_input_image(sc_input, mat_filename, job.X, job.Y, PBR_colorspaces[job.map_id], job.map_id))
+			{
+				smooth_contours_tiled(sc_input, int(job.X), int(job.Y), Q, curves, 1024, 64, tile_threads);
+				if (keyed)
+					save_contour_cache(cache_dir, key, job.X, job.Y, curves);
+				job.status = "extracted";
+			}
+			else
+			{
+				std::lock_guard<std::mutex> lock(log);
+				cout << "could not read " + mat_filename << endl;
+				continue;
+			}
 
-			saveContourImage(contour_x, contour_y, curve_limits, M, &contour_out[0], X, Y, 1.0);
+			save_contours(images, contour_out, curves.x.data(), curves.y.data(), curves.curve_limits.data(), curves.curves(), int(job.X), int(job.Y), 1.0);
 
-			cout << "writing " + contour_out << endl;
+			job.points = curves.points();
+			job.curves = curves.curves();
+			job.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - jobStart).count();
 
-			/* free memory */
-			free((void*)curve_limits);
-			free((void*)contour_x);
-			free((void*)contour_y);
-		}
-		else
-		{
-			cout << "could not read " + mat_filename << endl;
+			std::lock_guard<std::mutex> lock(log);
+			cout << mat_filename << ": " << job.curves << " contours, " << job.points << " points (" << job.status << ", " << job.seconds << " s)" << endl;
+			if (images != VisualOutput::None)
+				cout << "writing " + contour_out << endl;
 		}
+	}, 1, workers);
+	double total = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	// summary, one line per map
+	std::ofstream summary("contours_summary.csv");
+	if (summary.is_open())
+	{
+		summary << "material,map,width,height,curves,points,seconds,status" << endl;
+		for (contourJob const& job : jobs)
+			summary << job.material << "," << contour_maps[job.map_id] << "," << job.X << "," << job.Y << ","
+				<< job.curves << "," << job.points << "," << job.seconds << "," << job.status << endl;
 	}
-	
-	return EXIT_SUCCESS;
-}
\ No newline at end of file
+	else
+	{
+		std::cerr << "could not write contours_summary.csv" << std::endl;
+	}
+
+	unsigned int failed = (unsigned int)std::count_if(jobs.begin(), jobs.end(), [](contourJob const& job) { return job.status == "failed"; });
+	cout << jobs.size() - failed << "/" << jobs.size() << " maps extracted in " << total << " s, summary written to contours_summary.csv" << endl;
+
+	return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -10,6 +10,7 @@
 #include "glm/glm.hpp"
 
 #include "Utils/Color.h"
+#include "Utils/PolylineOutput.h"
 
 extern "C" 
 {
@@ -30,17 +31,29 @@ enum class ColorSpace
 
 void* xmalloc(size_t size);
 
+// reads the image as gray values in [0,255] resized to W*H, flipped vertically (bottom row first) if flip_vertically:
+// the luma of the linearized color map, the z component of the normal map, and the other maps as they are,
+// the heightmap normalized to its range. W and H set to 0 read the image at its native size, and are set to it.
+// Reentrant: images can be read from several threads
 bool read_input_image(
-	std::vector<double>& out,
+	std::vector<float>& out,
 	std::string filename,
-	size_t W, size_t H,
+	size_t& W, size_t& H,
 	ColorSpace color_space,
 	int map_id,
+	bool flip_vertically = false,
 	bool debug_out = false);
 
 void write_render_normal(std::string filename, std::string file_out);
 
-bool getContoursListFromMaps(std::string mat_name, int material_to_use, std::vector<vec2>& contourPts);
+// contour points in [0,1]^2 of the maps of the material selected by the bits of material_to_use
+// (color, height, metallic, normal, roughness from the highest bit), the maps are processed concurrently.
+// The maps are resampled to resolution*resolution, or read at their native size for a resolution of 0,
+// and extracted in tiles above 1024*1024 (see smooth_contours_tiled). With a cache_dir, the curves of
+// each map are read from the contour cache when it has them, and written to it otherwise (see ContourCache.h).
+// The merged contours are drawn to mat_name/warp_contours with the image output
+bool getContoursListFromMaps(std::string mat_name, int material_to_use, std::vector<vec2>& contourPts,
+	int resolution = 1024, std::string const& cache_dir = "", VisualOutput image = VisualOutput::Raster);
 
 void saveContourImage(
 	double* x, double* y, int* curve_limits, int M,
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+
+// number of worker threads used by parallel_for, at least 1
+inline unsigned int hardware_threads()
+{
+	return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// calls body(begin, end) on consecutive chunks of [first, last) from up to nthreads threads,
+// the chunks are handed out dynamically so that uneven workloads stay balanced
+template<typename Body>
+void parallel_for(size_t first, size_t last, Body body, size_t chunkSize = 256, unsigned int nthreads = hardware_threads())
+{
+	if (last <= first)
+		return;
+
+	size_t nchunks = (last - first + chunkSize - 1) / chunkSize;
+	nthreads = (unsigned int)std::min<size_t>(nthreads, nchunks);
+	if (nthreads <= 1)
+	{
+		body(first, last);
+		return;
+	}
+
+	std::atomic<size_t> nextChunk(0);
+	auto worker = [&]() {
+		for (size_t chunk = nextChunk++; chunk < nchunks; chunk = nextChunk++)
+		{
+			size_t begin = first + chunk * chunkSize;
+			body(begin, std::min(begin + chunkSize, last));
+		}
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(nthreads - 1);
+	for (unsigned int t = 1; t < nthreads; t++)
+		threads.emplace_back(worker);
+	worker();
+	for (std::thread& thread : threads)
+		thread.join();
+}
@@ -0,0 +1,144 @@
+#include "PolylineOutput.h"
+
+#include "stb_image_write.h"
+
+#include <cstdio>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+
+static const char polyline_magic[4] = { 'M', 'M', 'P', 'L' };
+static const uint32_t polyline_version = 1;
+
+bool parse_visual_output(std::string const& value, VisualOutput& output)
+{
+	if (value == "none" || value == "0")
+		output = VisualOutput::None;
+	else if (value == "preview")
+		output = VisualOutput::Preview;
+	else if (value == "svg")
+		output = VisualOutput::Svg;
+	else if (value == "polylines")
+		output = VisualOutput::Polylines;
+	else if (value == "raster" || value == "1")
+		output = VisualOutput::Raster;
+	else
+		return false;
+	return true;
+}
+
+bool write_svg(std::string const& filename, contourCurves const& curves, int width, int height, rgb8 color, double stroke)
+{
+	FILE* file = fopen(filename.c_str(), "w");
+	if (file == NULL)
+	{
+		std::cout << "failed to write " << filename << std::endl;
+		return false;
+	}
+
+	fprintf(file, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%d\" height=\"%d\" viewBox=\"0 0 %d %d\">\n", width, height, width, height);
+	fprintf(file, "<rect width=\"%d\" height=\"%d\" fill=\"white\"/>\n", width, height);
+	fprintf(file, "<g fill=\"none\" stroke=\"#%02x%02x%02x\" stroke-width=\"%g\" stroke-linejoin=\"round\">\n", color[0], color[1], color[2], stroke);
+	for (int k = 0; k < curves.curves(); k++)
+	{
+		if (curves.curve_limits[k + 1] - curves.curve_limits[k] < 2)
+			continue;
+		fprintf(file, "<polyline points=\"");
+		for (int i = curves.curve_limits[k]; i < curves.curve_limits[k + 1]; i++)
+			fprintf(file, i == curves.curve_limits[k] ? "%.2f,%.2f" : " %.2f,%.2f", curves.x[i], height - curves.y[i]);
+		fprintf(file, "\"/>\n");
+	}
+	fprintf(file, "</g>\n</svg>\n");
+
+	return fclose(file) == 0;
+}
+
+bool write_polylines(std::string const& filename, contourCurves const& curves, int width, int height)
+{
+	FILE* file = fopen(filename.c_str(), "wb");
+	if (file == NULL)
+	{
+		std::cout << "failed to write " << filename << std::endl;
+		return false;
+	}
+
+	uint32_t size[2] = { uint32_t(width), uint32_t(height) };
+	int32_t N = curves.points(), M = curves.curves();
+	std::vector<int32_t> limits(curves.curve_limits.begin(), curves.curve_limits.end());
+	std::vector<float> points(2 * size_t(N));
+	for (int i = 0; i < N; i++)
+	{
+		points[2 * i] = float(curves.x[i]);
+		points[2 * i + 1] = float(curves.y[i]);
+	}
+
+	bool ok = fwrite(polyline_magic, 1, 4, file) == 4
+		&& fwrite(&polyline_version, sizeof(polyline_version), 1, file) == 1
+		&& fwrite(size, sizeof(uint32_t), 2, file) == 2
+		&& fwrite(&N, sizeof(N), 1, file) == 1 && fwrite(&M, sizeof(M), 1, file) == 1
+		&& fwrite(limits.data(), sizeof(int32_t), limits.size(), file) == limits.size()
+		&& fwrite(points.data(), sizeof(float), points.size(), file) == points.size();
+
+	return (fclose(file) == 0) && ok;
+}
+
+bool write_preview(std::string const& filename, contourCurves const& curves, int width, int height, rgb8 color, int size)
+{
+	double scale = std::min(1.0, double(size) / std::max(width, height));
+	int W = std::max(1, int(std::lround(width * scale))), H = std::max(1, int(std::lround(height * scale)));
+	std::vector<unsigned char> image(3 * size_t(W) * H, 255);
+
+	auto plot = [&](int x, int y) {
+		if (x < 0 || y < 0 || x >= W || y >= H) return;
+		std::copy(color.begin(), color.end(), image.begin() + 3 * (size_t(H - 1 - y) * W + x));
+	};
+
+	// Bresenham segments between the scaled points
+	for (int k = 0; k < curves.curves(); k++)
+	{
+		for (int i = curves.curve_limits[k]; i < curves.curve_limits[k + 1]; i++)
+		{
+			int x1 = int(std::floor(scale * curves.x[i])), y1 = int(std::floor(scale * curves.y[i]));
+			int x0 = x1, y0 = y1;
+			if (i > curves.curve_limits[k])
+			{
+				x0 = int(std::floor(scale * curves.x[i - 1]));
+				y0 = int(std::floor(scale * curves.y[i - 1]));
+			}
+			int dx = std::abs(x1 - x0), dy = -std::abs(y1 - y0);
+			int sx = x0 < x1 ? 1 : -1, sy = y0 < y1 ? 1 : -1;
+			for (int error = dx + dy;;)
+			{
+				plot(x0, y0);
+				if (x0 == x1 && y0 == y1) break;
+				int e2 = 2 * error;
+				if (e2 >= dy) { error += dy; x0 += sx; }
+				if (e2 <= dx) { error += dx; y0 += sy; }
+			}
+		}
+	}
+
+	if (stbi_write_png(filename.c_str(), W, H, 3, image.data(), 0) == 0)
+	{
+		std::cout << "failed to write " << filename << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool save_polylines(VisualOutput output, std::string const& basename,
+	contourCurves const& curves, int width, int height, rgb8 color, double stroke)
+{
+	switch (output)
+	{
+	case VisualOutput::Preview:
+		return write_preview(basename + ".png", curves, width, height, color);
+	case VisualOutput::Svg:
+		return write_svg(basename + ".svg", curves, width, height, color, stroke);
+	case VisualOutput::Polylines:
+		return write_polylines(basename + ".polylines", curves, width, height);
+	default:
+		return true;
+	}
+}
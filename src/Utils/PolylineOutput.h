@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Utils/ContourTiles.h"
+
+#include <array>
+#include <string>
+
+// Visualizations of the curves of the command line (contours, warpgrids) without Qt: an SVG, a binary
+// polyline file, or a cheap preview raster of at most 512 pixels per side drawn without antialiasing.
+// The antialiased Qt rasters of saveContourImage and saveGridImage remain the Raster output.
+enum class VisualOutput
+{
+	None,
+	Preview,
+	Svg,
+	Polylines,
+	Raster
+};
+
+typedef std::array<unsigned char, 3> rgb8;
+
+// none|preview|svg|polylines|raster, and 0|1 for none|raster
+bool parse_visual_output(std::string const& value, VisualOutput& output);
+
+// The writers take the curves in pixels of a width*height image with the y axis up, like the Qt rasters.
+//
+// binary polylines, in the byte order of the machine:
+//   "MMPL" | version | width height | N M | curve_limits[M+1] (int32) | x y of the N points (float32, interleaved)
+bool write_svg(std::string const& filename, contourCurves const& curves, int width, int height, rgb8 color, double stroke);
+bool write_polylines(std::string const& filename, contourCurves const& curves, int width, int height);
+bool write_preview(std::string const& filename, contourCurves const& curves, int width, int height, rgb8 color, int size = 512);
+
+// writes basename.png, .svg or .polylines for the Preview, Svg and Polylines outputs, nothing for None
+// and Raster, which is left to the Qt writers. False if the file cannot be written
+bool save_polylines(VisualOutput output, std::string const& basename,
+	contourCurves const& curves, int width, int height, rgb8 color, double stroke);
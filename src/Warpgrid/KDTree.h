@@ -1,6 +1,7 @@
 #pragma once
 
 #include "ANN/ANN.h"
+#include "Utils/Parallel.h"
 #include <vector>
 #include <cassert>
 
@@ -54,7 +55,8 @@ public:
             ann_point[dimIt] = i_position[dimIt];
         }
         ANNidx idx ; ANNdist dd;
-        ANNtree->annkSearch( ann_point , 1 , &idx , &dd );
+        ANNsearchContext context;
+        ANNtree->annkSearch( context , ann_point , 1 , &idx , &dd );
         annDeallocPt(ann_point);
         return (unsigned int)( idx );
     }
@@ -63,7 +65,8 @@ public:
     // too many useless allocations will hurt your timings
     inline unsigned int nearest( ANNpoint const & ann_point ) const {
         ANNidx idx ; ANNdist dd;
-        ANNtree->annkSearch( ann_point , 1 , &idx , &dd );
+        ANNsearchContext context;
+        ANNtree->annkSearch( context , ann_point , 1 , &idx , &dd );
         return (unsigned int)( idx );
     }
 
@@ -81,7 +84,29 @@ public:
         for(unsigned int dimIt = 0 ; dimIt < points_dimension ; ++dimIt ) {
             ann_point[dimIt] = i_position[dimIt];
         }
-        ANNtree->annkSearch( ann_point , k , id_nearest_neighbors , square_distances_to_neighbors );
+        ANNsearchContext context;
+        ANNtree->annkSearch( context , ann_point , k , id_nearest_neighbors , square_distances_to_neighbors );
         annDeallocPt(ann_point);
     }
+
+    // knearest for all the queries at once, searched by up to nthreads threads. The k neighbors of queries[q] are stored
+    // in id_nearest_neighbors[ k*q ... k*q + k-1 ] by increasing SQUARE distance, the arrays are resized if needed.
+    // Each thread copies its queries into a single point buffer and reuses a single search context: no allocation per query.
+    template< class point_t >
+    void knearestAll( std::vector< point_t > const & queries , int k ,
+                      std::vector< ANNidx > & id_nearest_neighbors , std::vector< ANNdist > & square_distances_to_neighbors ,
+                      unsigned int nthreads = hardware_threads() ) const {
+        id_nearest_neighbors.resize( queries.size() * k );
+        square_distances_to_neighbors.resize( queries.size() * k );
+
+        parallel_for( 0 , queries.size() , [&]( size_t begin , size_t end ) {
+            std::vector< ANNcoord > ann_point( points_dimension );
+            ANNsearchContext context;
+            for( size_t q = begin ; q < end ; ++q ) {
+                for(unsigned int dimIt = 0 ; dimIt < points_dimension ; ++dimIt )
+                    ann_point[dimIt] = queries[q][dimIt];
+                ANNtree->annkSearch( context , ann_point.data() , k , &id_nearest_neighbors[k * q] , &square_distances_to_neighbors[k * q] );
+            }
+        } , 256 , nthreads );
+    }
 };
\ No newline at end of file
@@ -1,74 +1,317 @@
 #pragma once
 
 #include "Eigen/SparseCore"
-#include "Eigen/SparseCholesky"
+
+#include "SparseSolver.h"
 
 #include <vector>
-#include <map>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
 
+// Least squares system min |A x - b|^2 assembled directly as its normal equations AtA x = Atb.
+// A is never materialized: each equation (row of A) is accumulated into a preallocated AtA
+// whose sparsity pattern is declared once, by adding every equation between beginPattern()
+// and endPattern() (coefficients are ignored at that stage).
+//
+// Several systems whose matrices only differ by a few equations can be handled at once:
+// shared equations are accumulated once and take one right-hand side per system, while
+// equations given for a single system only contribute to that one.
+//
+// Each system is solved by its own sparseSolver, a simplicial LDLT by default. For least squares
+// solvers, which work on A itself, the equations are also recorded as the rows of A.
 class linearSystem {
-    std::vector< std::map< unsigned int , double > > _ASparse;
+public:
+    static const unsigned int maxEquationSize = 32;   // the equations of the adaptive warpgrid span more unknowns
+
+private:
+    unsigned int _columns , _nsystems;
+
+    Eigen::SparseMatrix<double> _pattern;   // common sparsity pattern of all the AtA
+    std::vector< Eigen::Triplet<double> > _patternTriplets;
+    bool _patternDone;
 
-    Eigen::SparseMatrix<double> _A , _At;
-    Eigen::SimplicialLDLT< Eigen::SparseMatrix<double> > _AtA_choleskyDecomposition;
+    std::vector< double > _sharedValues;                  // AtA values of the shared equations
+    std::vector< std::vector< double > > _ownValues;      // AtA values of the per-system equations
+    Eigen::MatrixXd _Atb;                                 // one column per system
 
-    std::vector< double > _b;
+    std::vector< Eigen::SparseMatrix<double> > _AtA;
+    std::vector< std::unique_ptr< sparseSolver > > _solvers;
+    std::vector< unsigned char > _patternAnalyzed;   // not vector<bool>: the systems are preprocessed concurrently
 
-    unsigned int _rows , _columns;
+    // the equations themselves, only recorded for the least squares solvers
+    bool _keepEquations;
+    std::vector< std::vector< Eigen::Triplet<double> > > _rows;   // coefficients of A, per system
+    std::vector< std::vector< double > > _b;
+    std::vector< Eigen::SparseMatrix<double> > _A;
+
+    std::vector< double > _analyzeTime , _factorizeTime , _solveTime;
+
+    // merges repeated columns, a column given twice keeps its last coefficient (like A(row,column) = value)
+    static unsigned int mergeColumns( unsigned int const * columns , double const * coefficients , unsigned int n ,
+                                      unsigned int * mergedColumns , double * mergedCoefficients ) {
+        assert( n <= maxEquationSize );
+        unsigned int m = 0;
+        for( unsigned int a = 0 ; a < n ; ++a ) {
+            unsigned int i = 0;
+            while( i < m && mergedColumns[i] != columns[a] ) ++i;
+            if( i == m ) {
+                mergedColumns[m] = columns[a];
+                ++m;
+            }
+            mergedCoefficients[i] = coefficients[a];
+        }
+        return m;
+    }
+
+    // position of the entry (row,column) in the values of _pattern
+    inline int valueIndex( unsigned int row , unsigned int column ) const {
+        int const * begin = _pattern.innerIndexPtr() + _pattern.outerIndexPtr()[column];
+        int const * end = _pattern.innerIndexPtr() + _pattern.outerIndexPtr()[column + 1];
+        int const * it = std::lower_bound( begin , end , int(row) );
+        assert( it != end && *it == int(row) && "the equation is not part of the declared sparsity pattern" );
+        return int( it - _pattern.innerIndexPtr() );
+    }
+
+    void accumulate( std::vector< double > & values , unsigned int const * columns , double const * coefficients , unsigned int n ) {
+        for( unsigned int a = 0 ; a < n ; ++a )
+            for( unsigned int b = 0 ; b < n ; ++b )
+                values[ valueIndex( columns[a] , columns[b] ) ] += coefficients[a] * coefficients[b];
+    }
+
+    void addRow( unsigned int system , unsigned int const * columns , double const * coefficients , unsigned int n , double rhs ) {
+        int row = int( _b[system].size() );
+        for( unsigned int a = 0 ; a < n ; ++a )
+            _rows[system].push_back( Eigen::Triplet< double >( row , columns[a] , coefficients[a] ) );
+        _b[system].push_back( rhs );
+    }
+
+    void addToPattern( unsigned int const * columns , unsigned int n ) {
+        for( unsigned int a = 0 ; a < n ; ++a ) {
+            assert( columns[a] < _columns );
+            for( unsigned int b = 0 ; b < n ; ++b )
+                _patternTriplets.push_back( Eigen::Triplet< double >( columns[a] , columns[b] , 0.0 ) );
+        }
+    }
 
 public:
-    linearSystem() {
-        _ASparse.clear();
-        setDimensions(0 , 0);
+    linearSystem( unsigned int columns , unsigned int nsystems = 1 ) : _columns( columns ) , _nsystems( nsystems ) , _patternDone( false ) , _keepEquations( false ) {
+        _ownValues.resize( _nsystems );
+        _AtA.resize( _nsystems );
+        _patternAnalyzed.assign( _nsystems , false );
+        _rows.resize( _nsystems );
+        _b.resize( _nsystems );
+        _A.resize( _nsystems );
+        _analyzeTime.assign( _nsystems , 0.0 );
+        _factorizeTime.assign( _nsystems , 0.0 );
+        _solveTime.assign( _nsystems , 0.0 );
+        for( unsigned int s = 0 ; s < _nsystems ; ++s )
+            _solvers.emplace_back( new ldltSolver() );
+    }
+
+    unsigned int columns() const { return _columns; }
+    unsigned int systems() const { return _nsystems; }
+
+    // replaces the solver of the system s, before the equations are added
+    void setSolver( unsigned int system , std::unique_ptr< sparseSolver > solver ) {
+        assert( system < _nsystems );
+        _solvers[system] = std::move( solver );
+        _patternAnalyzed[system] = false;
+        if( _solvers[system]->leastSquares() )
+            keepEquations();
+    }
+
+    sparseSolver const & solver( unsigned int system = 0 ) const { return *_solvers[system]; }
+
+    // also records the equations as the rows of A, before the equations are added
+    void keepEquations() { _keepEquations = true; }
+
+    void beginPattern() {
+        _patternTriplets.clear();
+        _patternDone = false;
+        _patternAnalyzed.assign( _nsystems , false );
     }
-    linearSystem( int rows , int columns ) {
-        _ASparse.clear();
-        setDimensions(rows , columns);
+
+    void endPattern() {
+        _pattern.resize( _columns , _columns );
+        _pattern.setFromTriplets( _patternTriplets.begin() , _patternTriplets.end() );
+        _pattern.makeCompressed();
+        std::vector< Eigen::Triplet< double > >().swap( _patternTriplets );
+        _patternDone = true;
+        clear();
     }
-    ~linearSystem() {
+
+    // zeroes all the equations, the sparsity pattern and symbolic factorizations are kept
+    void clear() {
+        assert( _patternDone );
+        _sharedValues.assign( _pattern.nonZeros() , 0.0 );
+        for( unsigned int s = 0 ; s < _nsystems ; ++s )
+            _ownValues[s].assign( _pattern.nonZeros() , 0.0 );
+        _Atb.setZero( _columns , _nsystems );
+        for( unsigned int s = 0 ; s < _nsystems ; ++s ) {
+            _rows[s].clear();
+            _b[s].clear();
+        }
     }
 
-    void setDimensions( int rows , int columns ) {
-        _rows = rows; _columns = columns;
-        _ASparse.resize(_rows);
-        _b.resize(_rows);
-        // this allows pushing equations without knowing in advance how much you have
+    // adds sum_a coefficients[a] * x[columns[a]] = rhs[s] to every system s
+    void addEquation( unsigned int const * columns , double const * coefficients , unsigned int n , double const * rhs ) {
+        if( !_patternDone ) {
+            addToPattern( columns , n );
+            return;
+        }
+        unsigned int mergedColumns[maxEquationSize];
+        double mergedCoefficients[maxEquationSize];
+        n = mergeColumns( columns , coefficients , n , mergedColumns , mergedCoefficients );
+
+        accumulate( _sharedValues , mergedColumns , mergedCoefficients , n );
+        for( unsigned int a = 0 ; a < n ; ++a )
+            for( unsigned int s = 0 ; s < _nsystems ; ++s )
+                _Atb( mergedColumns[a] , s ) += mergedCoefficients[a] * rhs[s];
+        if( _keepEquations )
+            for( unsigned int s = 0 ; s < _nsystems ; ++s )
+                addRow( s , mergedColumns , mergedCoefficients , n , rhs[s] );
     }
 
-    double & A(unsigned int row , unsigned int column) {
-        return _ASparse[row][column];
+    // adds sum_a coefficients[a] * x[columns[a]] = rhs to the system s only
+    void addEquation( unsigned int system , unsigned int const * columns , double const * coefficients , unsigned int n , double rhs ) {
+        assert( system < _nsystems );
+        if( !_patternDone ) {
+            addToPattern( columns , n );
+            return;
+        }
+        unsigned int mergedColumns[maxEquationSize];
+        double mergedCoefficients[maxEquationSize];
+        n = mergeColumns( columns , coefficients , n , mergedColumns , mergedCoefficients );
+
+        accumulate( _ownValues[system] , mergedColumns , mergedCoefficients , n );
+        for( unsigned int a = 0 ; a < n ; ++a )
+            _Atb( mergedColumns[a] , system ) += mergedCoefficients[a] * rhs;
+        if( _keepEquations )
+            addRow( system , mergedColumns , mergedCoefficients , n , rhs );
     }
 
-    double & b(unsigned int row) {
-        return _b[ row ];
+    // equations accumulated between two clear(), which can be added again later at a different scale
+    struct block {
+        std::vector< double > sharedValues;
+        std::vector< std::vector< double > > ownValues;
+        Eigen::MatrixXd Atb;
+        std::vector< std::vector< Eigen::Triplet<double> > > rows;  // when the equations are recorded
+        std::vector< std::vector< double > > b;
+    };
+
+    // moves the equations accumulated since the last clear() into a block, and clears the system
+    block takeBlock() {
+        block b;
+        b.sharedValues.swap( _sharedValues );
+        b.ownValues.swap( _ownValues );
+        b.Atb.swap( _Atb );
+        b.rows.swap( _rows );
+        b.b.swap( _b );
+        _ownValues.resize( _nsystems );
+        _rows.resize( _nsystems );
+        _b.resize( _nsystems );
+        clear();
+        return b;
     }
 
-    void preprocess() {
-        // convert ad-hoc matrix to Eigen sparse format:
-        {
-            _A.resize(_rows , _columns);
-            std::vector< Eigen::Triplet< double > > triplets;
-            for( unsigned int r = 0 ; r < _rows ; ++r ) {
-                for( std::map< unsigned int , double >::const_iterator it = _ASparse[r].begin() ; it != _ASparse[r].end() ; ++it ) {
-                    unsigned int c = it->first;
-                    double val = it->second;
-                    triplets.push_back( Eigen::Triplet< double >(r,c,val) );
-                }
-            }
-            _A.setFromTriplets( triplets.begin() , triplets.end() );
+    // adds the equations of the block with all their coefficients and right-hand sides multiplied by sqrt( scale )
+    void addBlock( block const & b , double scale = 1.0 ) {
+        assert( _patternDone && b.sharedValues.size() == _sharedValues.size() );
+        for( size_t i = 0 ; i < _sharedValues.size() ; ++i )
+            _sharedValues[i] += scale * b.sharedValues[i];
+        for( unsigned int s = 0 ; s < _nsystems ; ++s )
+            for( size_t i = 0 ; i < _ownValues[s].size() ; ++i )
+                _ownValues[s][i] += scale * b.ownValues[s][i];
+        _Atb += scale * b.Atb;
+        if( !_keepEquations )
+            return;
+        double rowScale = std::sqrt( scale );
+        for( unsigned int s = 0 ; s < _nsystems && s < b.rows.size() ; ++s ) {
+            int firstRow = int( _b[s].size() );
+            for( Eigen::Triplet< double > const & t : b.rows[s] )
+                _rows[s].push_back( Eigen::Triplet< double >( firstRow + t.row() , t.col() , rowScale * t.value() ) );
+            for( double rhs : b.b[s] )
+                _b[s].push_back( rowScale * rhs );
         }
-        _At = _A.transpose();
-        Eigen::SparseMatrix<double> const & leftMatrix = _At * _A;
-        _AtA_choleskyDecomposition.analyzePattern(leftMatrix);
-        _AtA_choleskyDecomposition.compute(leftMatrix);
     }
 
-    void solve( Eigen::VectorXd & X ) {
+    // AtA of the system s, valid after assemble( s ) or preprocess( s )
+    Eigen::SparseMatrix<double> const & AtA( unsigned int system ) const { return _AtA[system]; }
+    Eigen::VectorXd Atb( unsigned int system ) const { return _Atb.col( system ); }
+
+    // sums the shared and own equations of the system s into AtA( s )
+    void assemble( unsigned int system = 0 ) {
+        Eigen::SparseMatrix<double> & leftMatrix = _AtA[system];
+        if( leftMatrix.nonZeros() != _pattern.nonZeros() )
+            leftMatrix = _pattern;
+        double * values = leftMatrix.valuePtr();
+        for( size_t i = 0 ; i < _sharedValues.size() ; ++i )
+            values[i] = _sharedValues[i] + _ownValues[system][i];
+    }
+
+    // the recorded equations A and b of the system s, valid after assembleEquations( s ) or preprocess( s )
+    Eigen::SparseMatrix<double> const & A( unsigned int system ) const { return _A[system]; }
+    Eigen::VectorXd b( unsigned int system ) const { return Eigen::Map< const Eigen::VectorXd >( _b[system].data() , _b[system].size() ); }
 
-        Eigen::VectorXd _b_eigen( _b.size() );
-        for( unsigned int i = 0 ; i < _b.size() ; ++i )
-            _b_eigen[i] = _b[i];
+    void assembleEquations( unsigned int system = 0 ) {
+        assert( _keepEquations );
+        _A[system].resize( int( _b[system].size() ) , _columns );
+        _A[system].setFromTriplets( _rows[system].begin() , _rows[system].end() );
+        _A[system].makeCompressed();
+    }
 
-        X = _AtA_choleskyDecomposition.solve( _At * _b_eigen );
+    // bytes held by the normal equations (and recorded equations) of the system s
+    size_t memory( unsigned int system = 0 ) const {
+        size_t bytes = sparse_bytes( _pattern ) + 2 * size_t( _pattern.nonZeros() ) * sizeof( double ) + size_t( _columns ) * sizeof( double );
+        if( _keepEquations )
+            bytes += _rows[system].size() * sizeof( Eigen::Triplet<double> ) + _b[system].size() * sizeof( double ) + sparse_bytes( _A[system] );
+        return bytes;
     }
+
+    // assembles the system s and factorizes it, the systems can be preprocessed concurrently
+    void preprocess( unsigned int system = 0 ) {
+        auto start = std::chrono::steady_clock::now();
+
+        sparseSolver & solver = *_solvers[system];
+        assemble( system );
+        if( solver.leastSquares() )
+            assembleEquations( system );
+        Eigen::SparseMatrix<double> const & leftMatrix = solver.leastSquares() ? _A[system] : _AtA[system];
+
+        // the ordering and elimination tree only depend on the sparsity pattern:
+        // compute them once and only redo the numeric factorization afterwards.
+        // The number of equations, hence the pattern of A, can change from one call to the next
+        _analyzeTime[system] = 0.0;
+        if( !_patternAnalyzed[system] || solver.leastSquares() ) {
+            solver.analyzePattern( leftMatrix );
+            _patternAnalyzed[system] = true;
+            _analyzeTime[system] = std::chrono::duration< double >( std::chrono::steady_clock::now() - start ).count();
+        }
+        auto analyzed = std::chrono::steady_clock::now();
+
+        solver.factorize( leftMatrix );
+
+        _factorizeTime[system] = std::chrono::duration< double >( std::chrono::steady_clock::now() - analyzed ).count();
+    }
+
+    // solves the system s preprocessed by preprocess( s ), X holds the initial guess of the iterative solvers.
+    // Returns false when the solver failed
+    bool solve( unsigned int system , Eigen::VectorXd & X ) {
+        auto start = std::chrono::steady_clock::now();
+        bool solved = _solvers[system]->leastSquares() ? _solvers[system]->solve( b( system ) , X ) : _solvers[system]->solve( _Atb.col( system ) , X );
+        _solveTime[system] = std::chrono::duration< double >( std::chrono::steady_clock::now() - start ).count();
+        return solved;
+    }
+
+    bool solve( Eigen::VectorXd & X ) {
+        return solve( 0 , X );
+    }
+
+    // timings in seconds of the last call to preprocess( s ) and solve( s ), analyzeTime is 0 when the symbolic factorization was reused
+    double analyzeTime( unsigned int system = 0 ) const { return _analyzeTime[system]; }
+    double factorizeTime( unsigned int system = 0 ) const { return _factorizeTime[system]; }
+    double solveTime( unsigned int system = 0 ) const { return _solveTime[system]; }
 };
@@ -0,0 +1,200 @@
+#include "Multigrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <initializer_list>
+
+// bilinear interpolation of an Nc*Nc vertex grid at the vertices of an N*N one, both spanning [0,1]^2
+static Eigen::SparseMatrix<double> bilinear_prolongation(unsigned int N, unsigned int Nc, unsigned int components)
+{
+    std::vector< Eigen::Triplet<double> > triplets;
+    triplets.reserve(4 * N * N * components);
+
+    for (unsigned int l = 0; l < N; l++)
+    {
+        double y = l * (Nc - 1.0) / (N - 1.0);
+        unsigned int lc = std::min((unsigned int)std::floor(y), Nc - 2);
+        double fy = y - lc;
+
+        for (unsigned int k = 0; k < N; k++)
+        {
+            double x = k * (Nc - 1.0) / (N - 1.0);
+            unsigned int kc = std::min((unsigned int)std::floor(x), Nc - 2);
+            double fx = x - kc;
+
+            unsigned int coarse[4] = { kc + lc * Nc, kc + 1 + lc * Nc, kc + (lc + 1) * Nc, kc + 1 + (lc + 1) * Nc };
+            double weights[4] = { (1 - fx) * (1 - fy), fx * (1 - fy), (1 - fx) * fy, fx * fy };
+
+            for (unsigned int a = 0; a < 4; a++)
+            {
+                if (weights[a] == 0.0) continue;
+                for (unsigned int c = 0; c < components; c++)
+                    triplets.push_back(Eigen::Triplet<double>(components * (k + l * N) + c, components * coarse[a] + c, weights[a]));
+            }
+        }
+    }
+
+    Eigen::SparseMatrix<double> P(components * N * N, components * Nc * Nc);
+    P.setFromTriplets(triplets.begin(), triplets.end());
+    return P;
+}
+
+multigridPCG::multigridPCG(unsigned int N, unsigned int components, unsigned int coarsestN) : _components(components)
+{
+    _coarsestSolver.reset(new Eigen::SimplicialLDLT< Eigen::SparseMatrix<double> >());
+
+    _levels.push_back(level());
+    _levels.back().N = N;
+
+    while (_levels.back().N > coarsestN)
+    {
+        unsigned int Nc = (_levels.back().N + 1) / 2;
+        _levels.back().P = bilinear_prolongation(_levels.back().N, Nc, _components);
+        _levels.back().Pt = _levels.back().P.transpose();
+
+        _levels.push_back(level());
+        _levels.back().N = Nc;
+    }
+}
+
+void multigridPCG::compute(Eigen::SparseMatrix<double> const& A)
+{
+    _levels[0].A = A;
+    for (size_t l = 0; l + 1 < _levels.size(); l++)
+    {
+        Eigen::SparseMatrix<double> AP = _levels[l].A * _levels[l].P;
+        _levels[l + 1].A = _levels[l].Pt * AP;
+        _levels[l + 1].A.makeCompressed();
+    }
+
+    // the coarse operators keep the same sparsity pattern from one IRLS iteration to the next
+    Eigen::SparseMatrix<double> const& coarsest = _levels.back().A;
+    if (!_coarsestAnalyzed)
+    {
+        _coarsestSolver->analyzePattern(coarsest);
+        _coarsestAnalyzed = true;
+    }
+    _coarsestSolver->factorize(coarsest);
+
+    for (level& lvl : _levels)
+    {
+        lvl.b.setZero(lvl.A.rows());
+        lvl.x.setZero(lvl.A.rows());
+        lvl.r.setZero(lvl.A.rows());
+    }
+}
+
+size_t multigridPCG::memory() const
+{
+    size_t bytes = 0;
+    for (level const& lvl : _levels)
+    {
+        for (Eigen::SparseMatrix<double> const* M : { &lvl.A, &lvl.P, &lvl.Pt })
+            bytes += size_t(M->nonZeros()) * (sizeof(double) + sizeof(int)) + size_t(M->outerSize() + 1) * sizeof(int);
+        bytes += size_t(lvl.b.size() + lvl.x.size() + lvl.r.size()) * sizeof(double);
+    }
+    if (_coarsestAnalyzed)
+    {
+        Eigen::SparseMatrix<double> const& L = _coarsestSolver->matrixL().nestedExpression();
+        bytes += size_t(L.nonZeros()) * (sizeof(double) + sizeof(int)) + size_t(L.outerSize() + 1) * sizeof(int);
+    }
+    return bytes;
+}
+
+// forward then backward Gauss-Seidel sweeps, A is symmetric so its columns are also its rows
+void multigridPCG::smooth(level& lvl, Eigen::VectorXd const& b, Eigen::VectorXd& x) const
+{
+    Eigen::SparseMatrix<double> const& A = lvl.A;
+    int const* outer = A.outerIndexPtr();
+    int const* inner = A.innerIndexPtr();
+    double const* values = A.valuePtr();
+    int n = int(A.outerSize());
+
+    auto relax = [&](int i) {
+        double sum = b[i];
+        double diagonal = 0.0;
+        for (int p = outer[i]; p < outer[i + 1]; p++)
+        {
+            if (inner[p] == i) diagonal = values[p];
+            else sum -= values[p] * x[inner[p]];
+        }
+        if (diagonal != 0.0) x[i] = sum / diagonal;
+    };
+
+    for (unsigned int step = 0; step < _smoothingSteps; step++)
+    {
+        for (int i = 0; i < n; i++) relax(i);
+        for (int i = n - 1; i >= 0; i--) relax(i);
+    }
+}
+
+void multigridPCG::vcycle(size_t l, Eigen::VectorXd const& b, Eigen::VectorXd& x)
+{
+    if (l + 1 == _levels.size())
+    {
+        x = _coarsestSolver->solve(b);
+        return;
+    }
+
+    level& lvl = _levels[l];
+    level& coarse = _levels[l + 1];
+
+    smooth(lvl, b, x);
+
+    lvl.r = b - lvl.A * x;
+    coarse.b = lvl.Pt * lvl.r;
+    coarse.x.setZero();
+    vcycle(l + 1, coarse.b, coarse.x);
+    x += lvl.P * coarse.x;
+
+    smooth(lvl, b, x);
+}
+
+bool multigridPCG::solve(Eigen::VectorXd const& b, Eigen::VectorXd& x)
+{
+    Eigen::SparseMatrix<double> const& A = _levels[0].A;
+
+    if (x.size() != b.size())
+        x.setZero(b.size());
+
+    _iterations = 0;
+    double bNorm = b.norm();
+    if (bNorm == 0.0)
+    {
+        x.setZero();
+        _error = 0.0;
+        return true;
+    }
+
+    Eigen::VectorXd r = b - A * x;
+    _error = r.norm() / bNorm;
+    if (_error < _tolerance)
+        return true;
+
+    Eigen::VectorXd z = Eigen::VectorXd::Zero(b.size());
+    vcycle(0, r, z);
+    Eigen::VectorXd p = z;
+    Eigen::VectorXd Ap(b.size());
+    double rz = r.dot(z);
+
+    while (_iterations < _maxIterations)
+    {
+        Ap.noalias() = A * p;
+        double alpha = rz / p.dot(Ap);
+        x += alpha * p;
+        r -= alpha * Ap;
+        _iterations++;
+
+        _error = r.norm() / bNorm;
+        if (_error < _tolerance)
+            return true;
+
+        z.setZero();
+        vcycle(0, r, z);
+        double rzNew = r.dot(z);
+        p = z + (rzNew / rz) * p;
+        rz = rzNew;
+    }
+
+    return false;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Eigen/SparseCore"
+#include "Eigen/SparseCholesky"
+
+#include <vector>
+#include <memory>
+
+// Conjugate gradient on the normal matrix of an N*N warpgrid system, preconditioned by one
+// geometric multigrid V-cycle per iteration. The levels are nested warpgrids of halved size,
+// connected by bilinear interpolation; their operators are Galerkin products Pt A P, smoothed
+// with symmetric Gauss-Seidel, and the coarsest one is factored directly.
+// The unknowns are the components (1 for a decoupled coordinate, 2 for interleaved x,y) of the vertices.
+class multigridPCG {
+    struct level {
+        unsigned int N;
+        Eigen::SparseMatrix<double> A;
+        Eigen::SparseMatrix<double> P;      // prolongation from the next coarser level
+        Eigen::SparseMatrix<double> Pt;
+        Eigen::VectorXd b , x , r;          // V-cycle work vectors
+    };
+
+    unsigned int _components;
+    std::vector< level > _levels;
+    std::unique_ptr< Eigen::SimplicialLDLT< Eigen::SparseMatrix<double> > > _coarsestSolver;
+    bool _coarsestAnalyzed = false;
+
+    double _tolerance = 1e-8;
+    unsigned int _maxIterations = 500;
+    unsigned int _smoothingSteps = 2;
+
+    unsigned int _iterations = 0;
+    double _error = 0.0;
+
+    void smooth( level & lvl , Eigen::VectorXd const & b , Eigen::VectorXd & x ) const;
+    void vcycle( size_t l , Eigen::VectorXd const & b , Eigen::VectorXd & x );
+
+public:
+    // builds the grid hierarchy of an N*N warpgrid down to coarsestN*coarsestN vertices or less
+    multigridPCG( unsigned int N , unsigned int components = 1 , unsigned int coarsestN = 16 );
+
+    void setTolerance( double tolerance ) { _tolerance = tolerance; }
+    void setMaxIterations( unsigned int maxIterations ) { _maxIterations = maxIterations; }
+
+    // computes the coarse operators of the (symmetric positive definite) matrix A
+    void compute( Eigen::SparseMatrix<double> const & A );
+
+    // solves A x = b, the input x is used as the initial guess
+    bool solve( Eigen::VectorXd const & b , Eigen::VectorXd & x );
+
+    // number of iterations and relative residual |b - A x| / |b| of the last solve
+    unsigned int iterations() const { return _iterations; }
+    double error() const { return _error; }
+
+    // bytes held by the level operators, transfer matrices, work vectors and coarsest factorization
+    size_t memory() const;
+};
@@ -0,0 +1,167 @@
+#include "PeriodicGrid.h"
+#include "Utils/Parallel.h"
+
+#include <algorithm>
+
+static inline float wrap_unit(float x)
+{
+    return x - std::floor(x);
+}
+
+unsigned int periodicPointGrid::cellOf(float x) const
+{
+    return std::min((unsigned int)(x * _G), _G - 1);
+}
+
+void periodicPointGrid::build(std::vector<vec2> const& points, float pointsPerCell)
+{
+    size_t n = points.size();
+    _G = (unsigned int)std::sqrt(n / std::max(pointsPerCell, 1.0f));
+    _G = std::min(std::max(_G, 1u), 2048u);
+    _cellSize = 1.0f / _G;
+
+    // counting sort of the points by cell
+    std::vector<unsigned int> cells(n);
+    _cellStart.assign(_G * _G + 1, 0);
+    for (size_t i = 0; i < n; i++)
+    {
+        cells[i] = cellOf(wrap_unit(points[i][0])) + _G * cellOf(wrap_unit(points[i][1]));
+        _cellStart[cells[i] + 1]++;
+    }
+    for (unsigned int c = 0; c < _G * _G; c++)
+        _cellStart[c + 1] += _cellStart[c];
+
+    _x.resize(n);
+    _y.resize(n);
+    _index.resize(n);
+    std::vector<unsigned int> fill(_cellStart.begin(), _cellStart.end() - 1);
+    for (size_t i = 0; i < n; i++)
+    {
+        unsigned int p = fill[cells[i]]++;
+        _x[p] = wrap_unit(points[i][0]);
+        _y[p] = wrap_unit(points[i][1]);
+        _index[p] = int(i);
+    }
+}
+
+template<class Visitor>
+void periodicPointGrid::visitRing(unsigned int cx, unsigned int cy, int r, Visitor& visit) const
+{
+    int lo = std::max(-r, lowestOffset());
+    int hi = std::min(r, highestOffset());
+    int G = int(_G);
+
+    for (int dy = lo; dy <= hi; dy++)
+    {
+        unsigned int row = G * ((int(cy) + dy + G) % G);
+        auto visitCell = [&](int dx) {
+            unsigned int c = row + (int(cx) + dx + G) % G;
+            visit(_cellStart[c], _cellStart[c + 1]);
+        };
+
+        if (dy == -r || dy == r)
+        {
+            for (int dx = lo; dx <= hi; dx++)
+                visitCell(dx);
+        }
+        else
+        {
+            // inner rows of the ring: only its left and right cells
+            if (lo == -r) visitCell(-r);
+            if (hi == r) visitCell(r);
+        }
+    }
+}
+
+unsigned int periodicPointGrid::knearest(vec2 q, unsigned int k, int* indices, float* squareDistances, float maxRadius) const
+{
+    if (k == 0 || _G == 0)
+        return 0;
+
+    float qx = wrap_unit(q[0]), qy = wrap_unit(q[1]);
+    float squareRadius = maxRadius * maxRadius;
+    unsigned int found = 0;
+
+    auto visit = [&](unsigned int begin, unsigned int end) {
+        for (unsigned int p = begin; p < end; p++)
+        {
+            float dx = torusDelta(qx, _x[p]);
+            float dy = torusDelta(qy, _y[p]);
+            float d = dx * dx + dy * dy;
+            if (d > squareRadius || (found == k && d >= squareDistances[k - 1]))
+                continue;
+
+            // insertion in the sorted list of the closest points so far
+            unsigned int i = (found < k) ? found++ : k - 1;
+            while (i > 0 && squareDistances[i - 1] > d)
+            {
+                squareDistances[i] = squareDistances[i - 1];
+                indices[i] = indices[i - 1];
+                i--;
+            }
+            squareDistances[i] = d;
+            indices[i] = _index[p];
+        }
+    };
+
+    unsigned int cx = cellOf(qx), cy = cellOf(qy);
+    int lastRing = std::max(-lowestOffset(), highestOffset());
+    for (int r = 0; r <= lastRing; r++)
+    {
+        visitRing(cx, cy, r, visit);
+
+        // the cells beyond ring r are at least r cells away from q
+        float reach = r * _cellSize;
+        if (reach > maxRadius || (found == k && squareDistances[k - 1] <= reach * reach))
+            break;
+    }
+    return found;
+}
+
+unsigned int periodicPointGrid::radiusSearch(vec2 q, float radius, std::vector<int>& indices, std::vector<float>& squareDistances) const
+{
+    if (_G == 0)
+        return 0;
+
+    float qx = wrap_unit(q[0]), qy = wrap_unit(q[1]);
+    float squareRadius = radius * radius;
+    unsigned int found = 0;
+
+    auto visit = [&](unsigned int begin, unsigned int end) {
+        for (unsigned int p = begin; p < end; p++)
+        {
+            float dx = torusDelta(qx, _x[p]);
+            float dy = torusDelta(qy, _y[p]);
+            float d = dx * dx + dy * dy;
+            if (d > squareRadius)
+                continue;
+            indices.push_back(_index[p]);
+            squareDistances.push_back(d);
+            found++;
+        }
+    };
+
+    // cells of ring r start r-1 cells away from q
+    unsigned int cx = cellOf(qx), cy = cellOf(qy);
+    int lastRing = std::min(std::max(-lowestOffset(), highestOffset()), int(radius / _cellSize) + 1);
+    for (int r = 0; r <= lastRing; r++)
+        visitRing(cx, cy, r, visit);
+
+    return found;
+}
+
+void periodicPointGrid::knearestAll(std::vector<vec2> const& queries, unsigned int k,
+    std::vector<int>& indices, std::vector<float>& squareDistances, float maxRadius, unsigned int nthreads) const
+{
+    indices.resize(queries.size() * k);
+    squareDistances.resize(queries.size() * k);
+
+    parallel_for(0, queries.size(), [&](size_t begin, size_t end) {
+        for (size_t q = begin; q < end; q++)
+        {
+            unsigned int found = knearest(queries[q], k, &indices[k * q], &squareDistances[k * q], maxRadius);
+            std::fill(indices.begin() + k * q + found, indices.begin() + k * (q + 1), -1);
+            std::fill(squareDistances.begin() + k * q + found, squareDistances.begin() + k * (q + 1), 0.0f);
+        }
+    }, 256, nthreads);
+}
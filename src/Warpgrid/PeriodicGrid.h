@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Mat2.h"
+#include "Utils/Parallel.h"
+
+#include <vector>
+#include <cmath>
+
+using glm::vec2;
+
+// Spatial index of 2D points on the unit torus [0,1)^2, for the contours of tileable textures:
+// a point near u=0 is a neighbor of a point near u=1. The points are bucketed in a uniform
+// grid of cells, stored cell after cell as separate x and y float arrays, and the queries
+// visit rings of cells around the query cell until no closer point can remain.
+// Distances are toroidal, all the searches are const and can run concurrently.
+class periodicPointGrid {
+    unsigned int _G = 0;                    // cells per side
+    float _cellSize = 1.0f;
+    std::vector< unsigned int > _cellStart; // points of cell c are [ _cellStart[c] , _cellStart[c+1] )
+    std::vector< float > _x , _y;           // positions wrapped into [0,1), sorted by cell
+    std::vector< int > _index;              // index of each sorted point in the input
+
+    // canonical range of cell offsets [lo,hi]: every cell of a row is reached by exactly one offset
+    int lowestOffset() const { return -int( ( _G - 1 ) / 2 ); }
+    int highestOffset() const { return int( _G / 2 ); }
+
+    unsigned int cellOf( float x ) const;
+
+    // calls visit( begin , end ) on the point ranges of the cells at Chebyshev offset r of the cell (cx,cy)
+    template< class Visitor >
+    void visitRing( unsigned int cx , unsigned int cy , int r , Visitor & visit ) const;
+
+public:
+    // builds the index with about pointsPerCell points per cell on average
+    void build( std::vector< vec2 > const & points , float pointsPerCell = 2.0f );
+
+    size_t size() const { return _x.size(); }
+    unsigned int cellsPerSide() const { return _G; }
+
+    // b - a wrapped into [-0.5,0.5)^2, so that a + torusDelta(a,b) is the closest image of b to a
+    static inline float torusDelta( float a , float b ) {
+        float d = b - a;
+        return d - std::floor( d + 0.5f );
+    }
+    static inline vec2 torusDelta( vec2 a , vec2 b ) {
+        return vec2( torusDelta( a[0] , b[0] ) , torusDelta( a[1] , b[1] ) );
+    }
+
+    // the k nearest points of q within maxRadius (toroidal distances are at most sqrt(2)/2), sorted by
+    // increasing SQUARE toroidal distance, indices and squareDistances must hold k elements. Returns the
+    // number of points found, which is less than k when the index is smaller or fewer points lie within maxRadius
+    unsigned int knearest( vec2 q , unsigned int k , int * indices , float * squareDistances , float maxRadius = 1.0f ) const;
+
+    // appends the points within the toroidal distance radius (at most 0.5) of q, in no particular order,
+    // and returns their number
+    unsigned int radiusSearch( vec2 q , float radius , std::vector< int > & indices , std::vector< float > & squareDistances ) const;
+
+    // knearest for all the queries, searched by up to nthreads threads. The neighbors of queries[q] are stored
+    // in indices[ k*q ... k*q + k-1 ], missing neighbors have index -1
+    void knearestAll( std::vector< vec2 > const & queries , unsigned int k ,
+                      std::vector< int > & indices , std::vector< float > & squareDistances , float maxRadius = 1.0f ,
+                      unsigned int nthreads = hardware_threads() ) const;
+};
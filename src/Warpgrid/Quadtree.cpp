@@ -0,0 +1,267 @@
+#include "Quadtree.h"
+
+#include <algorithm>
+#include <iostream>
+#include <cstdlib>
+
+void quadtreeWarpgrid::accumulate(std::vector<term>& terms, std::vector<term> const& source, double weight)
+{
+    for (term const& s : source)
+    {
+        size_t i = 0;
+        while (i < terms.size() && terms[i].unknown != s.unknown) i++;
+        if (i == terms.size())
+            terms.push_back({ s.unknown, 0.0 });
+        terms[i].weight += weight * s.weight;
+    }
+}
+
+void quadtreeWarpgrid::setLeaf(unsigned int l)
+{
+    unsigned int s = size(_leaves[l]);
+    unsigned int x0 = _leaves[l].x * s, y0 = _leaves[l].y * s;
+    for (unsigned int y = y0; y < y0 + s; y++)
+        std::fill(_leafAt.begin() + y * _R + x0, _leafAt.begin() + y * _R + x0 + s, int(l));
+}
+
+void quadtreeWarpgrid::split(unsigned int l)
+{
+    leaf parent = _leaves[l];
+    _split[l] = true;
+    for (unsigned int c = 0; c < 4; c++)
+    {
+        _leaves.push_back({ parent.level + 1, 2 * parent.x + (c & 1), 2 * parent.y + (c >> 1) });
+        _split.push_back(false);
+        setLeaf((unsigned int)_leaves.size() - 1);
+    }
+}
+
+unsigned int quadtreeWarpgrid::addVertex(unsigned int x, unsigned int y)
+{
+    auto inserted = _vertexAt.insert(std::make_pair(key(x, y), (unsigned int)_vx.size()));
+    if (inserted.second)
+    {
+        _vx.push_back(x);
+        _vy.push_back(y);
+        _smallestLeaf.push_back(_R);
+    }
+    return inserted.first->second;
+}
+
+void quadtreeWarpgrid::build(std::vector<vec2> const& points, unsigned int minLevel, unsigned int maxLevel, unsigned int maxPoints)
+{
+    if (maxLevel > 11)
+    {
+        std::cerr << "the quadtree is limited to 2048 cells per side, got level " << maxLevel << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    _maxLevel = maxLevel;
+    _R = 1u << maxLevel;
+    minLevel = std::min(minLevel, maxLevel);
+
+    _leaves.clear();
+    _split.clear();
+    _leafAt.assign(size_t(_R) * _R, -1);
+    _vertexAt.clear();
+    _vx.clear();
+    _vy.clear();
+    _smallestLeaf.clear();
+    _expansion.clear();
+    _unknownVertex.clear();
+
+    // summed area table of the points per finest cell, to count the points of any cell in O(1)
+    std::vector<unsigned int> count(size_t(_R + 1) * (_R + 1), 0);
+    for (vec2 const& p : points)
+    {
+        unsigned int x = std::min((unsigned int)(std::max(p[0], 0.0f) * _R), _R - 1);
+        unsigned int y = std::min((unsigned int)(std::max(p[1], 0.0f) * _R), _R - 1);
+        count[(y + 1) * (_R + 1) + x + 1]++;
+    }
+    for (unsigned int y = 1; y <= _R; y++)
+        for (unsigned int x = 1; x <= _R; x++)
+            count[y * (_R + 1) + x] += count[y * (_R + 1) + x - 1] + count[(y - 1) * (_R + 1) + x] - count[(y - 1) * (_R + 1) + x - 1];
+    auto pointsIn = [&](leaf const& l) {
+        unsigned int s = size(l), x0 = l.x * s, y0 = l.y * s;
+        return count[(y0 + s) * (_R + 1) + x0 + s] - count[y0 * (_R + 1) + x0 + s]
+            - count[(y0 + s) * (_R + 1) + x0] + count[y0 * (_R + 1) + x0];
+    };
+
+    // refinement, coarse to fine: the children of a split leaf are appended after it
+    _leaves.push_back({ 0, 0, 0 });
+    _split.push_back(false);
+    setLeaf(0);
+    for (unsigned int l = 0; l < _leaves.size(); l++)
+    {
+        leaf current = _leaves[l];
+        if (current.level < minLevel || (current.level < maxLevel && pointsIn(current) > maxPoints))
+            split(l);
+    }
+
+    // 2:1 balance: a leaf two levels coarser than a neighbor (across an edge or a corner) is split
+    std::vector<unsigned int> pending;
+    for (unsigned int l = 0; l < _leaves.size(); l++)
+        if (!_split[l])
+            pending.push_back(l);
+    while (!pending.empty())
+    {
+        unsigned int l = pending.back();
+        pending.pop_back();
+        if (_split[l])
+            continue;
+        leaf current = _leaves[l];
+        int s = int(size(current)), x0 = int(current.x) * s, y0 = int(current.y) * s;
+        for (int dy = -1; dy <= 1; dy++)
+        {
+            for (int dx = -1; dx <= 1; dx++)
+            {
+                int nx = dx < 0 ? x0 - 1 : (dx > 0 ? x0 + s : x0);
+                int ny = dy < 0 ? y0 - 1 : (dy > 0 ? y0 + s : y0);
+                if ((dx == 0 && dy == 0) || nx < 0 || ny < 0 || nx >= int(_R) || ny >= int(_R))
+                    continue;
+                unsigned int n = leafIndexAt(nx, ny);
+                if (_leaves[n].level + 1 < current.level)
+                {
+                    split(n);
+                    for (unsigned int c = 1; c <= 4; c++)
+                        pending.push_back((unsigned int)_leaves.size() - c);
+                    pending.push_back(l);
+                }
+            }
+        }
+    }
+
+    // vertices: the corners of the leaves
+    for (unsigned int l = 0; l < _leaves.size(); l++)
+    {
+        if (_split[l])
+            continue;
+        unsigned int s = size(_leaves[l]), x0 = _leaves[l].x * s, y0 = _leaves[l].y * s;
+        unsigned int corners[4] = { addVertex(x0, y0), addVertex(x0 + s, y0), addVertex(x0, y0 + s), addVertex(x0 + s, y0 + s) };
+        for (unsigned int v : corners)
+            _smallestLeaf[v] = std::min(_smallestLeaf[v], s);
+    }
+
+    // hanging vertices: the middle of an edge of a leaf, the endpoints of the edge are their parents
+    std::vector<int> parents(2 * _vx.size(), -1);
+    std::vector<unsigned int> edgeSize(_vx.size(), 0);
+    for (unsigned int l = 0; l < _leaves.size(); l++)
+    {
+        if (_split[l] || _leaves[l].level == maxLevel)
+            continue;
+        unsigned int s = size(_leaves[l]), h = s / 2, x0 = _leaves[l].x * s, y0 = _leaves[l].y * s;
+        unsigned int edges[4][6] = {
+            { x0 + h, y0, x0, y0, x0 + s, y0 },
+            { x0 + h, y0 + s, x0, y0 + s, x0 + s, y0 + s },
+            { x0, y0 + h, x0, y0, x0, y0 + s },
+            { x0 + s, y0 + h, x0 + s, y0, x0 + s, y0 + s } };
+        for (unsigned int e = 0; e < 4; e++)
+        {
+            auto middle = _vertexAt.find(key(edges[e][0], edges[e][1]));
+            if (middle == _vertexAt.end())
+                continue;
+            parents[2 * middle->second] = int(_vertexAt.at(key(edges[e][2], edges[e][3])));
+            parents[2 * middle->second + 1] = int(_vertexAt.at(key(edges[e][4], edges[e][5])));
+            edgeSize[middle->second] = s;
+        }
+    }
+
+    // the other vertices are the unknowns, the hanging ones are expanded on the unknowns of their parents,
+    // a hanging parent is itself the middle of a longer edge: expanding by decreasing edge size sees the parents first
+    _expansion.resize(_vx.size());
+    for (unsigned int v = 0; v < _vx.size(); v++)
+    {
+        if (parents[2 * v] >= 0)
+            continue;
+        _expansion[v].push_back({ (unsigned int)_unknownVertex.size(), 1.0 });
+        _unknownVertex.push_back(v);
+    }
+    std::vector<unsigned int> hanging;
+    for (unsigned int v = 0; v < _vx.size(); v++)
+        if (parents[2 * v] >= 0)
+            hanging.push_back(v);
+    std::sort(hanging.begin(), hanging.end(), [&](unsigned int a, unsigned int b) { return edgeSize[a] > edgeSize[b]; });
+    for (unsigned int v : hanging)
+    {
+        accumulate(_expansion[v], _expansion[parents[2 * v]], 0.5);
+        accumulate(_expansion[v], _expansion[parents[2 * v + 1]], 0.5);
+    }
+}
+
+unsigned int quadtreeWarpgrid::leafCount() const
+{
+    return (unsigned int)std::count(_split.begin(), _split.end(), false);
+}
+
+void quadtreeWarpgrid::addLeafTerms(unsigned int l, double u, double v, std::vector<term>& terms) const
+{
+    unsigned int s = size(_leaves[l]), x0 = _leaves[l].x * s, y0 = _leaves[l].y * s;
+    unsigned int corners[4][2] = { { x0, y0 }, { x0 + s, y0 }, { x0, y0 + s }, { x0 + s, y0 + s } };
+    double weights[4] = { (1 - u) * (1 - v), u * (1 - v), (1 - u) * v, u * v };
+    for (unsigned int c = 0; c < 4; c++)
+        if (weights[c] != 0.0)
+            accumulate(terms, _expansion[_vertexAt.at(key(corners[c][0], corners[c][1]))], weights[c]);
+}
+
+unsigned int quadtreeWarpgrid::leafOf(vec2 p) const
+{
+    double x = std::min(std::max(double(p[0]), 0.0), 1.0) * _R;
+    double y = std::min(std::max(double(p[1]), 0.0), 1.0) * _R;
+    return leafIndexAt(std::min((unsigned int)x, _R - 1), std::min((unsigned int)y, _R - 1));
+}
+
+void quadtreeWarpgrid::interpolation(vec2 p, std::vector<term>& terms) const
+{
+    terms.clear();
+    double x = std::min(std::max(double(p[0]), 0.0), 1.0) * _R;
+    double y = std::min(std::max(double(p[1]), 0.0), 1.0) * _R;
+    unsigned int l = leafOf(p);
+    double s = size(_leaves[l]);
+    addLeafTerms(l, (x - _leaves[l].x * s) / s, (y - _leaves[l].y * s) / s, terms);
+}
+
+void quadtreeWarpgrid::interpolation(unsigned int x, unsigned int y, std::vector<term>& terms) const
+{
+    terms.clear();
+    unsigned int l = leafIndexAt(std::min(x, _R - 1), std::min(y, _R - 1));
+    unsigned int s = size(_leaves[l]);
+    addLeafTerms(l, double(x - _leaves[l].x * s) / s, double(y - _leaves[l].y * s) / s, terms);
+}
+
+Eigen::VectorXd quadtreeWarpgrid::identity() const
+{
+    Eigen::VectorXd X(2 * unknownCount());
+    for (unsigned int i = 0; i < unknownCount(); i++)
+    {
+        X[2 * i] = double(unknownX(i)) / _R;
+        X[2 * i + 1] = double(unknownY(i)) / _R;
+    }
+    return X;
+}
+
+vec2 quadtreeWarpgrid::warp(Eigen::VectorXd const& X, vec2 p) const
+{
+    std::vector<term> terms;
+    interpolation(p, terms);
+    double x = 0.0, y = 0.0;
+    for (term const& t : terms)
+    {
+        x += t.weight * X[2 * t.unknown];
+        y += t.weight * X[2 * t.unknown + 1];
+    }
+    return vec2(float(x), float(y));
+}
+
+Eigen::VectorXd quadtreeWarpgrid::resample(Eigen::VectorXd const& X, unsigned int N) const
+{
+    Eigen::VectorXd G(2 * N * N);
+    for (unsigned int l = 0; l < N; l++)
+    {
+        for (unsigned int k = 0; k < N; k++)
+        {
+            vec2 p = warp(X, vec2(float(k) / float(N - 1), float(l) / float(N - 1)));
+            G[2 * (k + l * N)] = p[0];
+            G[2 * (k + l * N) + 1] = p[1];
+        }
+    }
+    return G;
+}
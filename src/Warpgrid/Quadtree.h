@@ -0,0 +1,91 @@
+#pragma once
+
+#include "Mat2.h"
+
+#include "Eigen/Core"
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+using glm::vec2;
+
+// Adaptive warpgrid: a quadtree over [0,1]^2 whose leaves are refined where the contour points are
+// dense, from 2^minLevel up to 2^maxLevel cells per side. The warp is bilinear in each leaf, its
+// unknowns are the positions of the leaf corners. Neighbor leaves differ by at most one level (2:1
+// balance, across edges and corners), so the corner of a leaf that lies in the middle of the edge of
+// a coarser neighbor is a hanging vertex: it is not an unknown but the average of the edge endpoints,
+// which keeps the warp continuous. Like the uniform grid, the vertices span [0,1] inclusive and the
+// vertices on opposite borders are tied by the periodic equations of the solver.
+//
+// Vertices are addressed by integer coordinates on the finest grid, in [0,2^maxLevel].
+class quadtreeWarpgrid {
+public:
+    // contribution of an unknown to an interpolated value
+    struct term {
+        unsigned int unknown;
+        double weight;
+    };
+
+    struct leaf {
+        unsigned int level , x , y;   // the leaf covers [x,x+1]*[y,y+1] / 2^level
+    };
+
+private:
+    unsigned int _maxLevel = 0;
+    unsigned int _R = 1;                                        // finest cells per side
+    std::vector< leaf > _leaves;                                // leaves, and the split ones
+    std::vector< bool > _split;
+    std::vector< int > _leafAt;                                 // leaf covering each finest cell
+    std::unordered_map< uint64_t , unsigned int > _vertexAt;    // vertex of the integer coordinates
+    std::vector< unsigned int > _vx , _vy;                      // integer coordinates of each vertex
+    std::vector< unsigned int > _smallestLeaf;                  // size of the smallest leaf around each vertex
+    std::vector< std::vector< term > > _expansion;              // each vertex in terms of the unknowns
+    std::vector< unsigned int > _unknownVertex;                 // vertex of each unknown
+
+    uint64_t key( unsigned int x , unsigned int y ) const { return uint64_t( y ) * ( _R + 1 ) + x; }
+    unsigned int size( leaf const & l ) const { return _R >> l.level; }
+    unsigned int leafIndexAt( unsigned int x , unsigned int y ) const { return _leafAt[ y * _R + x ]; }
+    void setLeaf( unsigned int l );
+    void split( unsigned int l );
+    unsigned int addVertex( unsigned int x , unsigned int y );
+
+    // interpolation of the corners of the leaf l at the relative coordinates (u,v), added to terms
+    void addLeafTerms( unsigned int l , double u , double v , std::vector< term > & terms ) const;
+
+public:
+    // builds the quadtree of the points: cells holding more than maxPoints points are split up to maxLevel
+    void build( std::vector< vec2 > const & points , unsigned int minLevel , unsigned int maxLevel , unsigned int maxPoints );
+
+    // adds weight * source to terms, summing the weights of the same unknown
+    static void accumulate( std::vector< term > & terms , std::vector< term > const & source , double weight );
+
+    unsigned int maxLevel() const { return _maxLevel; }
+    unsigned int finestSize() const { return _R; }
+    unsigned int leafCount() const;
+    unsigned int vertexCount() const { return (unsigned int)_vx.size(); }
+    unsigned int unknownCount() const { return (unsigned int)_unknownVertex.size(); }
+
+    // integer coordinates of the vertex of an unknown, and the size of the smallest leaf around it
+    unsigned int unknownX( unsigned int i ) const { return _vx[ _unknownVertex[i] ]; }
+    unsigned int unknownY( unsigned int i ) const { return _vy[ _unknownVertex[i] ]; }
+    unsigned int unknownSpacing( unsigned int i ) const { return _smallestLeaf[ _unknownVertex[i] ]; }
+
+    // index of the leaf containing the point p of [0,1]^2 (clamped), the points of a leaf share their unknowns
+    unsigned int leafOf( vec2 p ) const;
+
+    // the unknowns interpolated at the point p of [0,1]^2 (clamped), with their weights
+    void interpolation( vec2 p , std::vector< term > & terms ) const;
+
+    // same at the integer coordinates (x,y) of [0,2^maxLevel]^2, exact on the leaf edges
+    void interpolation( unsigned int x , unsigned int y , std::vector< term > & terms ) const;
+
+    // the identity warp: the position of each unknown, as interleaved x,y coordinates
+    Eigen::VectorXd identity() const;
+
+    // the warp X (interleaved x,y coordinates of the unknowns) at p
+    vec2 warp( Eigen::VectorXd const & X , vec2 p ) const;
+
+    // the warp X sampled on the vertices of the uniform N*N warpgrid, in the layout of the uniform solver
+    Eigen::VectorXd resample( Eigen::VectorXd const & X , unsigned int N ) const;
+};
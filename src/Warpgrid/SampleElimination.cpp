@@ -0,0 +1,190 @@
+#include "SampleElimination.h"
+#include "PeriodicGrid.h"
+#include "Utils/Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+
+// max heap of the sample weights, which keeps the heap position of each sample for the weight updates
+class sampleHeap {
+    std::vector<double> const& _weights;
+    std::vector<unsigned int> _heap;
+    std::vector<unsigned int> _position;
+
+    bool above(unsigned int a, unsigned int b) const { return _weights[_heap[a]] > _weights[_heap[b]]; }
+
+    void swapNodes(unsigned int a, unsigned int b)
+    {
+        std::swap(_heap[a], _heap[b]);
+        _position[_heap[a]] = a;
+        _position[_heap[b]] = b;
+    }
+
+    void siftDown(unsigned int a)
+    {
+        for (;;)
+        {
+            unsigned int largest = a, left = 2 * a + 1, right = 2 * a + 2;
+            if (left < _heap.size() && above(left, largest)) largest = left;
+            if (right < _heap.size() && above(right, largest)) largest = right;
+            if (largest == a) return;
+            swapNodes(a, largest);
+            a = largest;
+        }
+    }
+
+public:
+    sampleHeap(std::vector<double> const& weights) : _weights(weights), _heap(weights.size()), _position(weights.size())
+    {
+        for (unsigned int i = 0; i < _heap.size(); i++)
+            _heap[i] = _position[i] = i;
+        for (unsigned int a = (unsigned int)(_heap.size() / 2); a-- > 0;)
+            siftDown(a);
+    }
+
+    unsigned int top() const { return _heap[0]; }
+
+    void pop()
+    {
+        swapNodes(0, (unsigned int)_heap.size() - 1);
+        _heap.pop_back();
+        if (!_heap.empty()) siftDown(0);
+    }
+
+    // the weight of sample i has decreased
+    void decreased(unsigned int i) { siftDown(_position[i]); }
+};
+
+std::vector<vec2> eliminate_samples(std::vector<vec2> const& points, size_t budget, float spacing)
+{
+    size_t n = points.size();
+    bool spacingMode = (budget == 0);
+    if ((spacingMode && spacing <= 0.0f) || (!spacingMode && budget >= n))
+        return points;
+
+    periodicPointGrid grid;
+    grid.build(points);
+
+    // samples closer than 2 rmax interact, rmin limits the weight of the closest ones (weight limiting of the paper)
+    static const unsigned int maxNeighbors = 32;
+    double rmax, rmin = 0.0;
+    if (spacingMode)
+    {
+        rmax = 0.5 * spacing;
+    }
+    else
+    {
+        // the paper uses the largest Poisson disk radius of budget points, here on the unit torus, whose
+        // 2 rmax disks hold pi (2 rmax)^2 n input points. Contour points concentrate on curves though: rmax
+        // is rather measured as half the mean distance to that many neighbors, on a subset of the points
+        double uniformRmax = std::sqrt(1.0 / (2.0 * std::sqrt(3.0) * budget));
+        unsigned int k = (unsigned int)std::ceil(3.14159265 * 4.0 * uniformRmax * uniformRmax * n);
+        k = std::min(std::max(k, 2u), std::min(maxNeighbors, (unsigned int)n - 1)) + 1; // +1 for the sample itself
+
+        size_t stride = std::max<size_t>(1, n / 1000);
+        std::vector<int> found(k);
+        std::vector<float> squareDistances(k);
+        double sum = 0.0;
+        size_t count = 0;
+        for (size_t i = 0; i < n; i += stride, count++)
+        {
+            unsigned int m = grid.knearest(points[i], k, found.data(), squareDistances.data());
+            sum += std::sqrt(squareDistances[m - 1]);
+        }
+        rmax = 0.5 * sum / count;
+        rmin = rmax * 0.65 * (1.0 - std::pow(double(budget) / n, 1.5));
+    }
+    float radius = float(std::min(2.0 * rmax, 0.5));
+    if (radius <= 0.0f)
+        radius = 1e-6f; // duplicated points only
+
+    auto weight = [&](float d) {
+        double w = 1.0 - std::max(double(d), rmin) / (2.0 * rmax);
+        w *= w; w *= w;
+        return w * w;
+    };
+
+    // neighborhoods, in parallel. With a point budget at most maxNeighbors, the closest ones, are kept
+    struct neighbor { unsigned int index; float weight; };
+    std::vector<std::vector<neighbor>> neighbors(n);
+    std::vector<double> weights(n, 0.0);
+    std::vector<unsigned int> aliveNeighbors(n);
+    parallel_for(0, n, [&](size_t begin, size_t end) {
+        std::vector<int> found;
+        std::vector<float> squareDistances;
+        for (size_t i = begin; i < end; i++)
+        {
+            found.clear();
+            squareDistances.clear();
+            if (spacingMode)
+            {
+                grid.radiusSearch(points[i], 1.001f * radius, found, squareDistances);
+            }
+            else
+            {
+                found.resize(maxNeighbors + 1);
+                squareDistances.resize(maxNeighbors + 1);
+                found.resize(grid.knearest(points[i], maxNeighbors + 1, found.data(), squareDistances.data(), 1.001f * radius));
+            }
+            for (size_t a = 0; a < found.size(); a++)
+            {
+                if (found[a] == int(i)) continue;
+                // the same distance from both ends, so that the radius neighborhoods are symmetric
+                vec2 const& p = points[std::min(int(i), found[a])];
+                vec2 const& q = points[std::max(int(i), found[a])];
+                float d = glm::length(periodicPointGrid::torusDelta(p, q));
+                if (d >= radius) continue;
+                neighbors[i].push_back({ (unsigned int)found[a], float(weight(d)) });
+                weights[i] += neighbors[i].back().weight;
+            }
+            aliveNeighbors[i] = (unsigned int)neighbors[i].size();
+        }
+    });
+
+    // the weight of i sums its neighbors, it decreases when any of them is removed: the samples
+    // depending on i are its neighbors, unless the neighborhoods were truncated
+    std::vector<std::vector<neighbor>> dependents;
+    if (spacingMode)
+    {
+        dependents.swap(neighbors);
+    }
+    else
+    {
+        dependents.resize(n);
+        for (size_t i = 0; i < n; i++)
+            for (neighbor const& j : neighbors[i])
+                dependents[j.index].push_back({ (unsigned int)i, j.weight });
+        std::vector<std::vector<neighbor>>().swap(neighbors);
+    }
+
+    // removes the heaviest sample and updates the weights of the samples depending on it
+    std::vector<bool> removed(n, false);
+    sampleHeap heap(weights);
+
+    size_t remaining = n;
+    while (remaining > budget)
+    {
+        unsigned int i = heap.top();
+        if (spacingMode && aliveNeighbors[i] == 0)
+            break; // no two remaining samples are closer than spacing
+
+        heap.pop();
+        removed[i] = true;
+        remaining--;
+
+        for (neighbor const& j : dependents[i])
+        {
+            if (removed[j.index]) continue;
+            // reset to exactly 0 once alone, rounding errors must not keep it above isolated samples
+            aliveNeighbors[j.index]--;
+            weights[j.index] = aliveNeighbors[j.index] > 0 ? weights[j.index] - j.weight : 0.0;
+            heap.decreased(j.index);
+        }
+    }
+
+    std::vector<vec2> kept;
+    kept.reserve(remaining);
+    for (size_t i = 0; i < n; i++)
+        if (!removed[i]) kept.push_back(points[i]);
+    return kept;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "Mat2.h"
+
+#include <vector>
+
+using glm::vec2;
+
+// Weighted sample elimination (Yuksel, "Sample Elimination for Generating Poisson Disk Sample Sets",
+// Eurographics 2015) of points on the unit torus [0,1)^2: the point with the most, and closest,
+// neighbors is removed until the requested number remains, which leaves a blue noise subset.
+// Either budget > 0 points are kept, or (budget == 0) points are removed until no two points
+// are closer than spacing. The neighborhoods are searched in parallel, the kept points are
+// returned in their input order.
+std::vector<vec2> eliminate_samples(std::vector<vec2> const& points, size_t budget, float spacing = 0.0f);
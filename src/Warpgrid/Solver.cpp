@@ -1,221 +1,1090 @@
 #include "Solver.h"
 #include "WarpUtils.h"
+#include "WarpgridFile.h"
+
+#include <sstream>
 
 using std::vector;
 using std::cout;
 using std::endl;
 
-void build_and_solve_linear_system(
-	std::vector<vec2> const& PiInit,
-	std::vector<vec2> const& Qj,
-	Eigen::VectorXd& X,
-	unsigned int N, float alpha, float beta,
-	unsigned int NIterations) // 10 by default
+// weight of the data equation of a contour point whose target is at square distance d2
+static double data_term_weight(double d2, double pExponent, double epsilonPrec, double gaussKernelStd)
 {
-	unsigned int knn = 10;
-	ANNidxArray id_nearest_neighbors = new ANNidx[knn];
-	ANNdistArray square_distances_to_neighbors = new ANNdist[knn];
-
-	BasicANNkdTree QKdtree;
-	QKdtree.setDimension(2);
-	QKdtree.build(Qj);
+	return std::exp(-d2 / gaussKernelStd) // localized kernel
+		* std::pow(d2 + epsilonPrec, (pExponent - 2) / 2.0);
+}
 
-	std::vector<vec2> Pi = PiInit;
+// distance at which the (decreasing) data term weight falls to cutoff times its value at distance 0
+static double data_term_radius(double cutoff, double pExponent, double epsilonPrec, double gaussKernelStd)
+{
+	double minWeight = cutoff * data_term_weight(0.0, pExponent, epsilonPrec, gaussKernelStd);
+	double lo = 0.0, hi = 1.0;
+	for (unsigned int step = 0; step < 50; step++)
+	{
+		double r = 0.5 * (lo + hi);
+		if (data_term_weight(r * r, pExponent, epsilonPrec, gaussKernelStd) < minWeight) hi = r;
+		else lo = r;
+	}
+	return hi;
+}
 
-	for (unsigned int iter = 0; iter < NIterations; ++iter) {
+// adds sum_a coeffs[a] * t(g[a]) = rhs[c] for both coordinates c of the grid vertices t
+static void add_coordinate_equations(
+	linearSystem& system, SolverLayout layout,
+	unsigned int const* g, double const* coeffs, unsigned int n, double const rhs[2])
+{
+	if (layout == SolverLayout::Decoupled)
+	{
+		system.addEquation(g, coeffs, n, rhs);
+		return;
+	}
+	unsigned int columns[linearSystem::maxEquationSize];
+	for (unsigned int c = 0; c < 2; c++)
+	{
+		for (unsigned int a = 0; a < n; a++)
+			columns[a] = 2 * g[a] + c;
+		system.addEquation(columns, coeffs, n, &rhs[c]);
+	}
+}
 
-		unsigned int ncolumns = 2 * N * N; // for x,y coords
+// adds sum_a coeffs[a] * t(g[a]) = rhs for the coordinate c (0: x, 1: y) of the grid vertices t only
+static void add_coordinate_equation(
+	linearSystem& system, SolverLayout layout, unsigned int c,
+	unsigned int const* g, double const* coeffs, unsigned int n, double rhs)
+{
+	if (layout == SolverLayout::Decoupled)
+	{
+		system.addEquation(c, g, coeffs, n, rhs);
+		return;
+	}
+	unsigned int columns[linearSystem::maxEquationSize];
+	for (unsigned int a = 0; a < n; a++)
+		columns[a] = 2 * g[a] + c;
+	system.addEquation(columns, coeffs, n, &rhs);
+}
 
-		unsigned int equationIndex = 0;
+// interior regularity term, weighted by alpha
+static void add_interior_regularity_equations(
+	linearSystem& mySystem, SolverLayout layout,
+	unsigned int N, float alpha)
+{
+	for (unsigned int l = 0; l < N; l++)
+	{
+		for (unsigned int k = 0; k < N; k++)
+		{
+			double shift[2] = { 0.0, 0.0 };
+			if (k == 0) shift[0] = 1.0;
+			if (k == N - 1) shift[0] = -1.0;
+			if (l == 0) shift[1] = 1.0;
+			if (l == N - 1) shift[1] = -1.0;
 
-		linearSystem mySystem;
+			unsigned int k_plus_one = (k == N - 1 ? 1 : k + 1);
+			unsigned int k_minus_one = (k == 0 ? N - 2 : k - 1);
+			unsigned int l_plus_one = (l == N - 1 ? 1 : l + 1);
+			unsigned int l_minus_one = (l == 0 ? N - 2 : l - 1);
 
-		double pExponent = 0.1;
-		double epsilonPrec = 0.001;
-		double gaussKernelStd = 0.001;
+			unsigned int g[5] = {
+				k + l * N,              // tkl
+				k_minus_one + l * N,    // tk-1l
+				k_plus_one + l * N,     // tk+1l
+				k + l_minus_one * N,    // tkl-1
+				k + l_plus_one * N };   // tkl+1
+			double coeffs[5] = { -4.0 * alpha, alpha, alpha, alpha, alpha };
+			double rhs[2] = { shift[0] * alpha, shift[1] * alpha };
+			add_coordinate_equations(mySystem, layout, g, coeffs, 5, rhs);
+		}
+	}
+}
 
-		for (unsigned int i = 0; i < Pi.size(); i++)
+// periodic harmonicity term on the grid borders, weighted by beta
+static void add_periodic_harmonicity_equations(
+	linearSystem& mySystem, SolverLayout layout,
+	unsigned int N, float beta)
+{
+	for (unsigned int l = 0; l < N; l++)
+	{
+		for (unsigned int k = 0; k < N; k++)
 		{
-			vec2 pi = Pi[i]; // current point : find closest target points
-			QKdtree.knearest(pi, knn, id_nearest_neighbors, square_distances_to_neighbors);
+			// vertical edges
+			if ((k == 0 || k == N - 1) && l != 0 && l != N - 1)
+			{
+				unsigned int g = k + l * N; // x_tkl
+				double coeff = beta;
+				add_coordinate_equation(mySystem, layout, 0, &g, &coeff, 1, k == N - 1 ? beta : 0.0);
 
-			for (unsigned int jClosestIt = 0; jClosestIt < knn; jClosestIt++)
+				if (k == 0) {
+					// add only once this condition to make the results "tilable" in the weak sense (-> periodic)
+					unsigned int g_periodic[2] = { (N - 1) + l * N, 0 + l * N };
+					double coeffs_periodic[2] = { -beta, beta };
+					add_coordinate_equation(mySystem, layout, 1, g_periodic, coeffs_periodic, 2, 0.0);
+				}
+			}
+
+			// horizontal edges
+			if ((l == 0 || l == N - 1) && k != 0 && k != N - 1)
 			{
-				mySystem.setDimensions(equationIndex + 2, ncolumns);
+				unsigned int g = k + l * N; // y_tkl
+				double coeff = beta;
+				add_coordinate_equation(mySystem, layout, 1, &g, &coeff, 1, l == N - 1 ? beta : 0.0);
 
-				if (int(id_nearest_neighbors[jClosestIt]) < 0 || int(id_nearest_neighbors[jClosestIt]) >= int(Qj.size()))
-				{
-					cout << "index: " << id_nearest_neighbors[jClosestIt] << endl;
+				if (l == 0) {
+					// add only once this condition to make the results "tilable" in the weak sense (-> periodic)
+					unsigned int g_periodic[2] = { k + (N - 1) * N, k + 0 * N };
+					double coeffs_periodic[2] = { -beta, beta };
+					add_coordinate_equation(mySystem, layout, 0, g_periodic, coeffs_periodic, 2, 0.0);
 				}
+			}
+
+			// corners
+			if ((k == 0 || k == N - 1) && (l == 0 || l == N - 1))
+			{
+				unsigned int g = k + l * N;
+				double coeff = beta;
+				add_coordinate_equation(mySystem, layout, 0, &g, &coeff, 1, k == N - 1 ? beta : 0.0); //x_tkl
+				add_coordinate_equation(mySystem, layout, 1, &g, &coeff, 1, l == N - 1 ? beta : 0.0); //y_tkl
+			}
+		}
+	}
+}
+
+// targets of each contour point in the data term, see settings.data_term for its weights
+static const unsigned int knn = 10;
+
+// x rows only touch x unknowns and y rows only touch y unknowns:
+// in decoupled layout each coordinate gets its own N*N system,
+// otherwise both are interleaved in a single 2*N*N system
+static unsigned int system_columns(SolverLayout layout, unsigned int N)
+{
+	return layout == SolverLayout::Decoupled ? N * N : 2 * N * N;
+}
+
+static unsigned int system_count(SolverLayout layout)
+{
+	return layout == SolverLayout::Decoupled ? 2 : 1;
+}
+
+// the solver of one system of an N*N warpgrid, whose vertices have components unknowns in it
+static std::unique_ptr<sparseSolver> make_sparse_solver(SolverBackend backend, unsigned int N, unsigned int components,
+	SolverSettings const& settings)
+{
+	switch (backend)
+	{
+	case SolverBackend::SparseLU:
+		return std::unique_ptr<sparseSolver>(new sparseLUSolver());
+	case SolverBackend::IncompleteCholeskyCG:
+		return std::unique_ptr<sparseSolver>(new incompleteCholeskyCGSolver(settings.pcg_tolerance, settings.pcg_max_iterations));
+	case SolverBackend::LeastSquaresCG:
+		return std::unique_ptr<sparseSolver>(new leastSquaresCGSolver(settings.pcg_tolerance, settings.pcg_max_iterations));
+	case SolverBackend::MultigridPCG:
+		return std::unique_ptr<sparseSolver>(new multigridSolver(N, components, settings.pcg_tolerance, settings.pcg_max_iterations));
+	default:
+		if (settings.mixed_precision)
+			return std::unique_ptr<sparseSolver>(new mixedLDLTSolver(settings.refinement_tolerance, settings.refinement_steps));
+		return std::unique_ptr<sparseSolver>(new ldltSolver());
+	}
+}
+
+// solves the system s with every backend from the initial guess X0, and reports the time, memory and residual
+// of the normal equations of each, and its largest deviation in grid cells from the double precision LDLT
+// solution. The equations of the system must have been recorded
+static void benchmark_sparse_solvers(linearSystem& system, unsigned int s, unsigned int N, unsigned int components,
+	SolverSettings const& settings, Eigen::VectorXd const& X0)
+{
+	system.assemble(s);
+	system.assembleEquations(s);
+	Eigen::SparseMatrix<double> const& AtA = system.AtA(s);
+	Eigen::VectorXd Atb = system.Atb(s);
+
+	std::cout << "Solver benchmark, system " << s << " (" << AtA.cols() << " unknowns, " << system.A(s).rows() << " equations, "
+		<< AtA.nonZeros() << " non zeros in AtA):" << std::endl;
+
+	SolverBackend backends[6] = { SolverBackend::LDLT, SolverBackend::LDLT, SolverBackend::SparseLU, SolverBackend::IncompleteCholeskyCG,
+		SolverBackend::LeastSquaresCG, SolverBackend::MultigridPCG };
+	Eigen::VectorXd reference;
+	for (unsigned int b = 0; b < 6; b++)
+	{
+		// the second one is the mixed precision LDLT
+		SolverSettings backendSettings = settings;
+		backendSettings.mixed_precision = (b == 1);
+		std::unique_ptr<sparseSolver> solver = make_sparse_solver(backends[b], N, components, backendSettings);
+		Eigen::SparseMatrix<double> const& M = solver->leastSquares() ? system.A(s) : AtA;
+		Eigen::VectorXd X = X0;
+
+		auto start = std::chrono::steady_clock::now();
+		solver->analyzePattern(M);
+		auto analyzed = std::chrono::steady_clock::now();
+		solver->factorize(M);
+		auto factorized = std::chrono::steady_clock::now();
+		bool solved = solver->solve(solver->leastSquares() ? system.b(s) : Atb, X);
+		auto end = std::chrono::steady_clock::now();
+
+		std::cout << "  " << solver->name()
+			<< ": analyze " << std::chrono::duration<double>(analyzed - start).count() << " s"
+			<< ", factorize " << std::chrono::duration<double>(factorized - analyzed).count() << " s"
+			<< ", solve " << std::chrono::duration<double>(end - factorized).count() << " s"
+			<< ", total " << std::chrono::duration<double>(end - start).count() << " s"
+			<< ", memory " << (solver->memory() + sparse_bytes(M)) / (1024.0 * 1024.0) << " MB";
+		if (solver->iterations() > 0)
+			std::cout << ", " << solver->iterations() << " iterations";
+		std::cout << ", residual " << (AtA * X - Atb).norm() / Atb.norm();
+		if (b == 0)
+			reference = X;
+		else
+			std::cout << ", deviation " << (X - reference).cwiseAbs().maxCoeff() * (N - 1.0) << " cells";
+		if (!solved)
+			std::cout << " (failed)";
+		std::cout << std::endl;
+	}
+}
+
+warpgridSession::warpgridSession(std::vector<vec2> const& PiInit, std::vector<vec2> const& Qj,
+	unsigned int N, SolverSettings const& settings)
+	: _PiInit(PiInit), _Qj(Qj), _N(N), _settings(settings),
+	_system(system_columns(settings.layout, N), system_count(settings.layout))
+{
+	SolverLayout layout = _settings.layout;
+	unsigned int components = (layout == SolverLayout::Decoupled) ? 1 : 2;
+
+	// the least squares backend, and the benchmark of all the backends, need the equations themselves
+	for (unsigned int s = 0; s < _system.systems(); s++)
+		_system.setSolver(s, make_sparse_solver(_settings.backend, N, components, _settings));
+	if (_settings.benchmark)
+		_system.keepEquations();
+
+	if (_settings.neighbors == NeighborSearch::PeriodicGrid)
+	{
+		_QGrid.build(_Qj);
+	}
+	else
+	{
+		_QKdtree.setDimension(2);
+		_QKdtree.build(_Qj);
+	}
+
+	// the grid cell of each point is evaluated at PiInit, it does not change across iterations
+	_cells.resize(4 * _PiInit.size());
+	_cellCoords.resize(2 * _PiInit.size());
+	for (unsigned int i = 0; i < _PiInit.size(); i++)
+	{
+		std::vector<int> grid_coords;
+		get_bilinear_interpolation(grid_coords, _cellCoords[2 * i], _cellCoords[2 * i + 1], _PiInit[i], N);
+		std::copy(grid_coords.begin(), grid_coords.end(), _cells.begin() + 4 * i);
+	}
+
+	// the sparsity pattern of AtA only depends on PiInit: declare it once, so that the
+	// normal equations are accumulated in place and the symbolic factorization is reused
+	_system.beginPattern();
+	{
+		std::vector<bool> declaredCell(N * N, false);
+		double zeros[4] = { 0.0, 0.0, 0.0, 0.0 };
+		for (unsigned int i = 0; i < _PiInit.size(); i++)
+		{
+			unsigned int const* g = &_cells[4 * i];
+			bool regularCell = g[1] == g[0] + 1 && g[2] == g[0] + N && g[3] == g[0] + N + 1;
+			if (regularCell && declaredCell[g[0]]) continue;
+			if (regularCell) declaredCell[g[0]] = true;
+			add_coordinate_equations(_system, layout, g, zeros, 4, zeros);
+		}
+		add_interior_regularity_equations(_system, layout, N, 1.0f);
+		add_periodic_harmonicity_equations(_system, layout, N, 1.0f);
+	}
+	_system.endPattern();
+
+	// the regularization equations are linear in alpha and beta: their normal equations
+	// are accumulated once, and scaled by alpha^2 and beta^2 at each solve
+	add_interior_regularity_equations(_system, layout, N, 1.0f);
+	_interiorRegularity = _system.takeBlock();
+	add_periodic_harmonicity_equations(_system, layout, N, 1.0f);
+	_periodicHarmonicity = _system.takeBlock();
+}
+
+// calls addEquation(i, weight, qj) for each target qj of each current point Pi[i] kept in the data term,
+// and returns the number of pruned equations
+template<class EquationAdder>
+static unsigned int for_each_data_target(std::vector<vec2> const& Pi, std::vector<vec2> const& Qj, SolverSettings const& settings,
+	periodicPointGrid const& QGrid, BasicANNkdTree const& QKdtree,
+	double gaussKernelStd, double pExponent, double epsilonPrec, EquationAdder addEquation)
+{
+	bool periodic = (settings.neighbors == NeighborSearch::PeriodicGrid);
+
+	// fixed-radius mode: targets beyond the radius where the weight falls below the cutoff are pruned,
+	// the grid does not even search them
+	bool pruning = settings.weight_cutoff > 0.0;
+	double minWeight = settings.weight_cutoff * data_term_weight(0.0, pExponent, epsilonPrec, gaussKernelStd);
+	float searchRadius = pruning ? float(data_term_radius(settings.weight_cutoff, pExponent, epsilonPrec, gaussKernelStd)) + 1e-6f : 1.0f;
+	unsigned int prunedEquations = 0;
+
+	// closest target points of all the current points, searched in parallel
+	std::vector<ANNidx> id_nearest_neighbors;
+	std::vector<ANNdist> square_distances_to_neighbors;
+	std::vector<float> torus_square_distances_to_neighbors;
+	if (periodic)
+		QGrid.knearestAll(Pi, knn, id_nearest_neighbors, torus_square_distances_to_neighbors, searchRadius, settings.threads);
+	else
+		QKdtree.knearestAll(Pi, knn, id_nearest_neighbors, square_distances_to_neighbors, settings.threads);
+
+	for (unsigned int i = 0; i < Pi.size(); i++)
+	{
+		vec2 pi = Pi[i]; // current point
+		ANNidx const* neighbors = &id_nearest_neighbors[knn * i];
+
+		for (unsigned int jClosestIt = 0; jClosestIt < knn; jClosestIt++)
+		{
+			if (pruning && int(neighbors[jClosestIt]) < 0) // no target within the search radius
+			{
+				prunedEquations++;
+				continue;
+			}
+			if (int(neighbors[jClosestIt]) < 0 || int(neighbors[jClosestIt]) >= int(Qj.size()))
+			{
+				cout << "index: " << neighbors[jClosestIt] << endl;
+			}
+
+			// on the torus, the target is the image of qj closest to pi
+			vec2 qj = Qj[neighbors[jClosestIt]];
+			if (periodic)
+				qj = pi + periodicPointGrid::torusDelta(pi, qj);
 
-				vec2 qj = Qj[id_nearest_neighbors[jClosestIt]];
-
-				double weight =
-					std::exp(-glm::dot(pi - qj, pi - qj) / gaussKernelStd) // localized kernel
-					* std::pow(glm::dot(pi - qj, pi - qj) + epsilonPrec, (pExponent - 2) / 2.0);
-
-				std::vector<int> grid_coords;
-				float u, v;
-				get_bilinear_interpolation(grid_coords, u, v, PiInit[i], N);
-
-				// X coord
-				mySystem.A(equationIndex, 2 * grid_coords[0]) = weight * (1 - u) * (1 - v); // Gkl
-				mySystem.A(equationIndex, 2 * grid_coords[1]) = weight * u * (1 - v);       // Gk+1l
-				mySystem.A(equationIndex, 2 * grid_coords[2]) = weight * (1 - u) * v;       // Gkl+1
-				mySystem.A(equationIndex, 2 * grid_coords[3]) = weight * u * v;             // Gk+1l+1
-				mySystem.b(equationIndex) = weight * qj[0];
-				equationIndex += 1;
-
-				// Y coord
-				mySystem.A(equationIndex, 2 * grid_coords[0] + 1) = weight * (1 - u) * (1 - v); // Gkl
-				mySystem.A(equationIndex, 2 * grid_coords[1] + 1) = weight * u * (1 - v);       // Gk+1l
-				mySystem.A(equationIndex, 2 * grid_coords[2] + 1) = weight * (1 - u) * v;       // Gkl+1
-				mySystem.A(equationIndex, 2 * grid_coords[3] + 1) = weight * u * v;             // Gk+1l+1
-				mySystem.b(equationIndex) = weight * qj[1];
-				equationIndex += 1;
+			double weight = data_term_weight(glm::dot(pi - qj, pi - qj), pExponent, epsilonPrec, gaussKernelStd);
+			if (pruning && weight < minWeight)
+			{
+				prunedEquations++;
+				continue;
 			}
+
+			addEquation(i, weight, qj);
 		}
+	}
+	return prunedEquations;
+}
+
+// mean distance from the points Pi to their closest target
+static double mean_target_distance(std::vector<vec2> const& Pi, SolverSettings const& settings,
+	periodicPointGrid const& QGrid, BasicANNkdTree const& QKdtree)
+{
+	if (Pi.empty())
+		return 0.0;
+
+	std::vector<ANNidx> closest;
+	double sum = 0.0;
+	if (settings.neighbors == NeighborSearch::PeriodicGrid)
+	{
+		std::vector<float> squareDistances;
+		QGrid.knearestAll(Pi, 1, closest, squareDistances, 1.0f, settings.threads);
+		for (float d2 : squareDistances)
+			sum += std::sqrt(d2);
+	}
+	else
+	{
+		std::vector<ANNdist> squareDistances;
+		QKdtree.knearestAll(Pi, 1, closest, squareDistances, settings.threads);
+		for (ANNdist d2 : squareDistances)
+			sum += std::sqrt(d2);
+	}
+	return sum / Pi.size();
+}
+
+unsigned int warpgridSession::addDataEquations(std::vector<vec2> const& Pi, double gaussKernelStd, double pExponent, double epsilonPrec)
+{
+	SolverLayout layout = _settings.layout;
+	return for_each_data_target(Pi, _Qj, _settings, _QGrid, _QKdtree, gaussKernelStd, pExponent, epsilonPrec,
+		[&](unsigned int i, double weight, vec2 qj) {
+			float u = _cellCoords[2 * i], v = _cellCoords[2 * i + 1];
+			double coeffs[4] = {
+				weight * (1 - u) * (1 - v), // Gkl
+				weight * u * (1 - v),       // Gk+1l
+				weight * (1 - u) * v,       // Gkl+1
+				weight * u * v };           // Gk+1l+1
+			double rhs[2] = { weight * qj[0], weight * qj[1] };
+			add_coordinate_equations(_system, layout, &_cells[4 * i], coeffs, 4, rhs);
+		});
+}
+
+double warpgridSession::meanTargetDistance(std::vector<vec2> const& Pi) const
+{
+	return mean_target_distance(Pi, _settings, _QGrid, _QKdtree);
+}
+
+unsigned int warpgridSession::solve(Eigen::VectorXd& X, float alpha, float beta, unsigned int NIterations)
+{
+	unsigned int N = _N;
+	bool decoupled = (_settings.layout == SolverLayout::Decoupled);
+	unsigned int nsystems = _system.systems();
+
+	std::vector<vec2> Pi = _PiInit;
+
+	// start from the given grid when there is one (e.g. upsampled from a coarser level),
+	// otherwise from the identity grid
+	bool fromIdentity = (X.size() != 2 * N * N);
+	if (!fromIdentity)
+	{
+		for (unsigned int i = 0; i < Pi.size(); i++)
+			Pi[i] = warp_point(X, _PiInit[i], N);
+	}
+	else
+	{
+		X.resize(2 * N * N);
+		for (unsigned int g = 0; g < N * N; ++g) {
+			vec2 cell = get_grid_cell(g, N);
+			X[2 * g] = cell[0];
+			X[2 * g + 1] = cell[1];
+		}
+	}
 
+	unsigned int iterations = 0;
+	bool converged = false;
+	_convergence.clear();
+	double tolerance = _settings.irls_tolerance / (N - 1.0); // in texture space
+
+	for (unsigned int iter = 0; iter < NIterations && !converged; ++iter) {
+
+		auto iterationStart = std::chrono::steady_clock::now();
+
+		_system.clear();
+
+		double gaussKernelStd, pExponent, epsilonPrec;
+		_settings.data_term.at(iter, gaussKernelStd, pExponent, epsilonPrec);
+
+		// the first data term from the identity grid does not depend on alpha and beta: it is built once
+		unsigned int prunedEquations;
+		bool reusedDataTerm = (iter == 0 && fromIdentity && _identityDataTermCached);
+		if (reusedDataTerm)
 		{
-			for (unsigned int l = 0; l < N; l++)
+			_system.addBlock(_identityDataTerm);
+			prunedEquations = _identityPrunedEquations;
+		}
+		else
+		{
+			prunedEquations = addDataEquations(Pi, gaussKernelStd, pExponent, epsilonPrec);
+			if (iter == 0 && fromIdentity)
 			{
-				for (unsigned int k = 0; k < N; k++)
-				{
-					{
-						mySystem.setDimensions(equationIndex + 2, ncolumns);
-
-						double x_shift = 0.0;
-						if (k == 0) x_shift = 1.0;
-						if (k == N - 1) x_shift = -1.0;
-						double y_shift = 0.0;
-						if (l == 0) y_shift = 1.0;
-						if (l == N - 1) y_shift = -1.0;
-
-						unsigned int k_plus_one = (k == N - 1 ? 1 : k + 1);
-						unsigned int k_minus_one = (k == 0 ? N - 2 : k - 1);
-						unsigned int l_plus_one = (l == N - 1 ? 1 : l + 1);
-						unsigned int l_minus_one = (l == 0 ? N - 2 : l - 1);
-
-						mySystem.A(equationIndex, 2 * (k + l * N)) = -4.0 * alpha;    // x_tkl
-						mySystem.A(equationIndex, 2 * (k_minus_one + l * N)) = alpha; // x_tk-1l
-						mySystem.A(equationIndex, 2 * (k_plus_one + l * N)) = alpha; // x_tk+1l
-						mySystem.A(equationIndex, 2 * (k + l_minus_one * N)) = alpha; // x_tkl-1
-						mySystem.A(equationIndex, 2 * (k + l_plus_one * N)) = alpha; // x_tkl+1
-						mySystem.b(equationIndex) = x_shift * alpha;
-						equationIndex += 1;
-
-						mySystem.A(equationIndex, 2 * (k + l * N) + 1) = -4.0 * alpha;    // y_tkl
-						mySystem.A(equationIndex, 2 * (k + l_minus_one * N) + 1) = alpha; // y_tkl-1
-						mySystem.A(equationIndex, 2 * (k + l_plus_one * N) + 1) = alpha; // y_tkl+1
-						mySystem.A(equationIndex, 2 * (k_minus_one + (l * N)) + 1) = alpha; // y_tk-1l
-						mySystem.A(equationIndex, 2 * (k_plus_one + (l * N)) + 1) = alpha; // y_tk+1l
-						mySystem.b(equationIndex) = y_shift * alpha;
-						equationIndex += 1;
-					}
-
-					// vertical edges
-					if ((k == 0 || k == N - 1) && l != 0 && l != N - 1)
-					{
-						mySystem.setDimensions(equationIndex + 1, ncolumns);
-
-						mySystem.A(equationIndex, 2 * (k + l * N)) = beta; // x_tkl
-						if (k == N - 1) mySystem.b(equationIndex) = beta;
-						else mySystem.b(equationIndex) = 0.0;
-						equationIndex += 1;
-
-						if (k == 0) {
-							mySystem.setDimensions(equationIndex + 1, ncolumns);
-							// add only once this condition to make the results "tilable" in the weak sense (-> periodic)
-							mySystem.A(equationIndex, 2 * ((N - 1) + l * N) + 1) = -beta;
-							mySystem.A(equationIndex, 2 * (0 + l * N) + 1) = beta;
-							mySystem.b(equationIndex) = 0.0;
-							equationIndex += 1;
-						}
-					}
-
-					// horizontal edges
-					if ((l == 0 || l == N - 1) && k != 0 && k != N - 1)
-					{
-						mySystem.setDimensions(equationIndex + 1, ncolumns);
-
-						mySystem.A(equationIndex, 2 * (k + l * N) + 1) = beta; // y_tkl
-						if (l == N - 1) mySystem.b(equationIndex) = beta;
-						else mySystem.b(equationIndex) = 0.0;
-						equationIndex += 1;
-
-
-						if (l == 0) {
-							mySystem.setDimensions(equationIndex + 1, ncolumns);
-							// add only once this condition to make the results "tilable" in the weak sense (-> periodic)
-							mySystem.A(equationIndex, 2 * (k + (N - 1) * N)) = -beta;
-							mySystem.A(equationIndex, 2 * (k + 0 * N)) = beta;
-							mySystem.b(equationIndex) = 0.0;
-							equationIndex += 1;
-						}
-					}
-
-					// corners
-					if ((k == 0 || k == N - 1) && (l == 0 || l == N - 1))
-					{
-						mySystem.setDimensions(equationIndex + 2, ncolumns);
-
-						mySystem.A(equationIndex, 2 * (k + l * N)) = beta; //x_tkl
-						if (k == N - 1) mySystem.b(equationIndex) = beta;  else mySystem.b(equationIndex) = 0.0;
-						equationIndex += 1;
-
-						mySystem.A(equationIndex, 2 * (k + l * N) + 1) = beta; //y_tkl
-						if (l == N - 1) mySystem.b(equationIndex) = beta;  else mySystem.b(equationIndex) = 0.0;
-						equationIndex += 1;
-					}
-				}
+				_identityDataTerm = _system.takeBlock();
+				_identityPrunedEquations = prunedEquations;
+				_identityDataTermCached = true;
+				_system.addBlock(_identityDataTerm);
+			}
+		}
+
+		auto dataTermBuilt = std::chrono::steady_clock::now();
+
+		_system.addBlock(_interiorRegularity, double(alpha) * alpha);
+		_system.addBlock(_periodicHarmonicity, double(beta) * beta);
+
+		auto equationsBuilt = std::chrono::steady_clock::now();
+
+		// previous iterate, as a warm start for the iterative solver and to measure convergence
+		Eigen::VectorXd Xprevious = X;
+
+		// solves the system s, Xs holds the initial guess for iterative solvers
+		auto solveSystem = [&](unsigned int s, Eigen::VectorXd& Xs) {
+			_system.preprocess(s);
+			if (!_system.solve(s, Xs))
+				std::cout << "warning: " << _system.solver(s).name() << " failed for system " << s << std::endl;
+		};
+
+		bool benchmark = _settings.benchmark && !_benchmarked;
+		_benchmarked = _benchmarked || benchmark;
+
+		if (decoupled)
+		{
+			// the two half-size systems are independent: solve them concurrently
+			Eigen::VectorXd Xc[2] = { Eigen::VectorXd(N * N), Eigen::VectorXd(N * N) };
+			for (unsigned int g = 0; g < N * N; ++g) {
+				Xc[0][g] = X[2 * g];
+				Xc[1][g] = X[2 * g + 1];
+			}
+
+			if (benchmark)
+				for (unsigned int s = 0; s < 2; s++)
+					benchmark_sparse_solvers(_system, s, N, 1, _settings, Xc[s]);
+
+			std::future<void> ySolve = std::async(std::launch::async, [&]() { solveSystem(1, Xc[1]); });
+			solveSystem(0, Xc[0]);
+			ySolve.get();
+
+			for (unsigned int g = 0; g < N * N; ++g) {
+				X[2 * g] = Xc[0][g];
+				X[2 * g + 1] = Xc[1][g];
 			}
 		}
+		else
+		{
+			if (benchmark)
+				benchmark_sparse_solvers(_system, 0, N, 2, _settings, X);
+			solveSystem(0, X);
+		}
 
-		mySystem.preprocess();
-		mySystem.solve(X);
+		auto solved = std::chrono::steady_clock::now();
 
-		float advectionStep = float((iter + 1) / NIterations);
+		// the systems are factored concurrently in decoupled layout: report the slowest one
+		double analyzeTime = 0.0, factorizeTime = 0.0;
+		for (unsigned int s = 0; s < nsystems; s++)
+		{
+			analyzeTime = std::max(analyzeTime, _system.analyzeTime(s));
+			factorizeTime = std::max(factorizeTime, _system.factorizeTime(s));
+		}
+		if (analyzeTime > 0.0) _symbolicTime = analyzeTime;
 
-		std::cout << "Linear system solve: " << iter << "/" << NIterations - 1 << std::endl;
+		std::cout << "Linear system solve: " << iter << "/" << NIterations - 1;
+		if (reusedDataTerm)
+			std::cout << " (reused data term";
+		else
+			std::cout << " (knn and data term " << std::chrono::duration<double>(dataTermBuilt - iterationStart).count() << " s";
+		std::cout << ", regularization " << std::chrono::duration<double>(equationsBuilt - dataTermBuilt).count() << " s";
+		bool iterative = _settings.backend == SolverBackend::IncompleteCholeskyCG
+			|| _settings.backend == SolverBackend::LeastSquaresCG || _settings.backend == SolverBackend::MultigridPCG;
+		if (iterative)
+		{
+			for (unsigned int s = 0; s < nsystems; s++)
+				std::cout << ", " << _system.solver(s).name() << " " << _system.solver(s).iterations()
+					<< " iterations (residual " << _system.solver(s).error() << ")";
+			std::cout << ", total " << std::chrono::duration<double>(solved - iterationStart).count() << " s)";
+		}
+		else
+		{
+			std::cout << ", symbolic " << analyzeTime << " s"
+				<< ", numeric " << factorizeTime << " s"
+				<< ", total " << std::chrono::duration<double>(solved - iterationStart).count() << " s)";
+			if (analyzeTime == 0.0 && _symbolicTime > 0.0)
+				std::cout << ", reused symbolic factorization: saved " << _symbolicTime << " s";
+			if (_settings.backend == SolverBackend::LDLT && _settings.mixed_precision)
+				for (unsigned int s = 0; s < nsystems; s++)
+					std::cout << ", refinement " << _system.solver(s).iterations() << " steps (residual " << _system.solver(s).error() << ")";
+		}
+		// largest displacement of a grid vertex and of an advected contour point in this iteration
+		double gridChange = 0.0;
+		for (unsigned int g = 0; g < N * N; ++g)
+			gridChange = std::max(gridChange, std::hypot(X[2 * g] - Xprevious[2 * g], X[2 * g + 1] - Xprevious[2 * g + 1]));
 
+		double contourChange = 0.0;
 		for (unsigned int i = 0; i < Pi.size(); ++i) {
 
 			// find out where the grid put the point:
-			std::vector<int> grid_coords;
-			float u, v;
-			get_bilinear_interpolation(grid_coords, u, v, PiInit[i], N);
+			unsigned int const* grid_coords = &_cells[4 * i];
+			float u = _cellCoords[2 * i], v = _cellCoords[2 * i + 1];
 
 			vec2 PiTarget = (1 - u) * (1 - v) * vec2(X[2 * grid_coords[0]], X[2 * grid_coords[0] + 1]) +
 				u * (1 - v) * vec2(X[2 * grid_coords[1]], X[2 * grid_coords[1] + 1]) +
 				(1 - u) * v * vec2(X[2 * grid_coords[2]], X[2 * grid_coords[2] + 1]) +
 				u * v * vec2(X[2 * grid_coords[3]], X[2 * grid_coords[3] + 1]);
 
-			Pi[i] += advectionStep * (PiTarget - Pi[i]);
+			contourChange = std::max(contourChange, double(glm::length(PiTarget - Pi[i])));
+			Pi[i] = PiTarget;
+		}
+
+		if (_settings.weight_cutoff > 0.0)
+			std::cout << ", pruned " << prunedEquations << "/" << knn * Pi.size() << " data equations";
+		if (_settings.data_term.steps > 1)
+			std::cout << ", kernel " << gaussKernelStd << ", p " << pExponent << ", epsilon " << epsilonPrec;
+		std::cout << ", grid change " << gridChange << ", contour change " << contourChange << std::endl;
+
+		if (_settings.convergence)
+		{
+			irlsIteration it = { gaussKernelStd, pExponent, epsilonPrec, gridChange * (N - 1.0), contourChange * (N - 1.0),
+				meanTargetDistance(Pi) * (N - 1.0), std::chrono::duration<double>(solved - iterationStart).count() };
+			_convergence.push_back(it);
+		}
+
+		// the changes only tell convergence once the data term parameters reached their final values
+		iterations = iter + 1;
+		converged = gridChange < tolerance && contourChange < tolerance && int(iterations) >= _settings.data_term.steps;
+	}
+
+	if (converged)
+		std::cout << "IRLS converged after " << iterations << " iterations" << std::endl;
+	else
+		std::cout << "IRLS stopped after " << iterations << " iterations without reaching tolerance " << tolerance << std::endl;
+
+	return iterations;
+}
+
+unsigned int build_and_solve_linear_system(
+	std::vector<vec2> const& PiInit,
+	std::vector<vec2> const& Qj,
+	Eigen::VectorXd& X,
+	unsigned int N, float alpha, float beta,
+	unsigned int NIterations, // 10 by default
+	SolverSettings const& settings)
+{
+	warpgridSession session(PiInit, Qj, N, settings);
+	return session.solve(X, alpha, beta, NIterations);
+}
+
+// adds sum_t scale * weight_t * t(unknown_t) = rhs, for both coordinates or for the coordinate c only
+static void add_term_equations(
+	linearSystem& system, SolverLayout layout,
+	std::vector<quadtreeWarpgrid::term> const& terms, double scale, double const rhs[2], int c = -1)
+{
+	if (terms.size() > linearSystem::maxEquationSize)
+	{
+		std::cerr << "an equation of the adaptive warpgrid spans " << terms.size() << " unknowns, more than "
+			<< linearSystem::maxEquationSize << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	unsigned int g[linearSystem::maxEquationSize];
+	double coeffs[linearSystem::maxEquationSize];
+	unsigned int n = (unsigned int)terms.size();
+	for (unsigned int a = 0; a < n; a++)
+	{
+		g[a] = terms[a].unknown;
+		coeffs[a] = scale * terms[a].weight;
+	}
+	if (c < 0)
+		add_coordinate_equations(system, layout, g, coeffs, n, rhs);
+	else
+		add_coordinate_equation(system, layout, (unsigned int)c, g, coeffs, n, rhs[c]);
+}
+
+// interior regularity term of the adaptive warpgrid, weighted by alpha: the Laplacian of each unknown with the
+// warp at the size h of the smallest leaf around it, across the periodic borders like the uniform grid
+static void add_quadtree_regularity_equations(
+	linearSystem& mySystem, SolverLayout layout,
+	quadtreeWarpgrid const& tree, float alpha)
+{
+	unsigned int R = tree.finestSize();
+	std::vector<quadtreeWarpgrid::term> terms, neighbor;
+	for (unsigned int i = 0; i < tree.unknownCount(); i++)
+	{
+		unsigned int x = tree.unknownX(i), y = tree.unknownY(i), h = tree.unknownSpacing(i);
+
+		double shift[2] = { 0.0, 0.0 };
+		if (x == 0) shift[0] = 1.0;
+		if (x == R) shift[0] = -1.0;
+		if (y == 0) shift[1] = 1.0;
+		if (y == R) shift[1] = -1.0;
+
+		unsigned int neighbors[4][2] = {
+			{ x == 0 ? R - h : x - h, y },
+			{ x == R ? h : x + h, y },
+			{ x, y == 0 ? R - h : y - h },
+			{ x, y == R ? h : y + h } };
+
+		terms.assign(1, { i, -4.0 });
+		for (unsigned int n = 0; n < 4; n++)
+		{
+			tree.interpolation(neighbors[n][0], neighbors[n][1], neighbor);
+			quadtreeWarpgrid::accumulate(terms, neighbor, 1.0);
+		}
+		double rhs[2] = { shift[0] * alpha, shift[1] * alpha };
+		add_term_equations(mySystem, layout, terms, alpha, rhs);
+	}
+}
+
+// periodic harmonicity term of the adaptive warpgrid on its borders, weighted by beta. Opposite borders
+// are not subdivided alike: each border unknown is tied to the warp interpolated at the opposite border
+static void add_quadtree_periodic_harmonicity_equations(
+	linearSystem& mySystem, SolverLayout layout,
+	quadtreeWarpgrid const& tree, float beta)
+{
+	unsigned int R = tree.finestSize();
+	std::vector<bool> rowTied(R + 1, false), columnTied(R + 1, false);
+	std::vector<quadtreeWarpgrid::term> terms, opposite;
+	for (unsigned int i = 0; i < tree.unknownCount(); i++)
+	{
+		unsigned int x = tree.unknownX(i), y = tree.unknownY(i);
+		bool vertical = (x == 0 || x == R), horizontal = (y == 0 || y == R);
+		std::vector<quadtreeWarpgrid::term> self(1, { i, 1.0 });
+
+		if (vertical)
+		{
+			double rhs[2] = { x == R ? beta : 0.0, 0.0 };
+			add_term_equations(mySystem, layout, self, beta, rhs, 0); // x_t
+		}
+		if (horizontal)
+		{
+			double rhs[2] = { 0.0, y == R ? beta : 0.0 };
+			add_term_equations(mySystem, layout, self, beta, rhs, 1); // y_t
+		}
+
+		// once per row or column of border unknowns, to make the results "tilable" in the weak sense (-> periodic)
+		double zeros[2] = { 0.0, 0.0 };
+		if (vertical && !horizontal && !rowTied[y])
+		{
+			rowTied[y] = true;
+			tree.interpolation(R, y, opposite);
+			terms.clear();
+			quadtreeWarpgrid::accumulate(terms, opposite, -1.0);
+			tree.interpolation(0, y, opposite);
+			quadtreeWarpgrid::accumulate(terms, opposite, 1.0);
+			add_term_equations(mySystem, layout, terms, beta, zeros, 1);
+		}
+		if (horizontal && !vertical && !columnTied[x])
+		{
+			columnTied[x] = true;
+			tree.interpolation(x, R, opposite);
+			terms.clear();
+			quadtreeWarpgrid::accumulate(terms, opposite, -1.0);
+			tree.interpolation(x, 0, opposite);
+			quadtreeWarpgrid::accumulate(terms, opposite, 1.0);
+			add_term_equations(mySystem, layout, terms, beta, zeros, 0);
+		}
+	}
+}
+
+// the backend of the adaptive warpgrid systems, which have no multigrid hierarchy
+static SolverSettings quadtree_settings(SolverSettings settings)
+{
+	if (settings.backend == SolverBackend::MultigridPCG)
+	{
+		std::cout << "the multigrid solver needs a uniform warpgrid: the adaptive warpgrid is solved with cg" << std::endl;
+		settings.backend = SolverBackend::IncompleteCholeskyCG;
+	}
+	if (settings.benchmark)
+	{
+		std::cout << "the solver benchmark only runs on uniform warpgrids" << std::endl;
+		settings.benchmark = false;
+	}
+	return settings;
+}
+
+// builds the quadtree, for the size of the systems
+static unsigned int quadtree_unknowns(std::vector<vec2> const& PiInit, unsigned int minLevel, unsigned int maxLevel, unsigned int maxPoints,
+	quadtreeWarpgrid& tree)
+{
+	tree.build(PiInit, minLevel, maxLevel, maxPoints);
+	return tree.unknownCount();
+}
+
+quadtreeWarpgridSession::quadtreeWarpgridSession(std::vector<vec2> const& PiInit, std::vector<vec2> const& Qj,
+	unsigned int minLevel, unsigned int maxLevel, unsigned int maxPoints, SolverSettings const& settings)
+	: _PiInit(PiInit), _Qj(Qj), _settings(quadtree_settings(settings)),
+	_system((settings.layout == SolverLayout::Decoupled ? 1 : 2) * quadtree_unknowns(PiInit, minLevel, maxLevel, maxPoints, _tree),
+		system_count(settings.layout))
+{
+	SolverLayout layout = _settings.layout;
+	unsigned int components = (layout == SolverLayout::Decoupled) ? 1 : 2;
+
+	for (unsigned int s = 0; s < _system.systems(); s++)
+		_system.setSolver(s, make_sparse_solver(_settings.backend, 0, components, _settings));
+
+	if (_settings.neighbors == NeighborSearch::PeriodicGrid)
+	{
+		_QGrid.build(_Qj);
+	}
+	else
+	{
+		_QKdtree.setDimension(2);
+		_QKdtree.build(_Qj);
+	}
+
+	// the interpolation of each point is evaluated at PiInit, it does not change across iterations
+	_termStart.assign(1, 0);
+	std::vector<quadtreeWarpgrid::term> terms;
+	for (unsigned int i = 0; i < _PiInit.size(); i++)
+	{
+		_tree.interpolation(_PiInit[i], terms);
+		_terms.insert(_terms.end(), terms.begin(), terms.end());
+		_termStart.push_back((unsigned int)_terms.size());
+	}
+
+	_system.beginPattern();
+	{
+		std::vector<bool> declaredLeaf;
+		double zeros[2] = { 0.0, 0.0 };
+		for (unsigned int i = 0; i < _PiInit.size(); i++)
+		{
+			unsigned int l = _tree.leafOf(_PiInit[i]);
+			if (l >= declaredLeaf.size())
+				declaredLeaf.resize(l + 1, false);
+			if (declaredLeaf[l]) continue;
+			declaredLeaf[l] = true;
+			terms.assign(_terms.begin() + _termStart[i], _terms.begin() + _termStart[i + 1]);
+			add_term_equations(_system, layout, terms, 0.0, zeros);
+		}
+		add_quadtree_regularity_equations(_system, layout, _tree, 1.0f);
+		add_quadtree_periodic_harmonicity_equations(_system, layout, _tree, 1.0f);
+	}
+	_system.endPattern();
+
+	add_quadtree_regularity_equations(_system, layout, _tree, 1.0f);
+	_interiorRegularity = _system.takeBlock();
+	add_quadtree_periodic_harmonicity_equations(_system, layout, _tree, 1.0f);
+	_periodicHarmonicity = _system.takeBlock();
+}
+
+unsigned int quadtreeWarpgridSession::addDataEquations(std::vector<vec2> const& Pi, double gaussKernelStd, double pExponent, double epsilonPrec)
+{
+	SolverLayout layout = _settings.layout;
+	unsigned int g[linearSystem::maxEquationSize];
+	double coeffs[linearSystem::maxEquationSize];
+	return for_each_data_target(Pi, _Qj, _settings, _QGrid, _QKdtree, gaussKernelStd, pExponent, epsilonPrec,
+		[&](unsigned int i, double weight, vec2 qj) {
+			unsigned int n = _termStart[i + 1] - _termStart[i];
+			for (unsigned int a = 0; a < n; a++)
+			{
+				g[a] = _terms[_termStart[i] + a].unknown;
+				coeffs[a] = weight * _terms[_termStart[i] + a].weight;
+			}
+			double rhs[2] = { weight * qj[0], weight * qj[1] };
+			add_coordinate_equations(_system, layout, g, coeffs, n, rhs);
+		});
+}
+
+unsigned int quadtreeWarpgridSession::solve(Eigen::VectorXd& X, float alpha, float beta, unsigned int NIterations)
+{
+	unsigned int F = _tree.unknownCount();
+	double R = _tree.finestSize();
+	bool decoupled = (_settings.layout == SolverLayout::Decoupled);
+	unsigned int nsystems = _system.systems();
+
+	// the current points, interpolated in the leaves of PiInit
+	auto advect = [&](std::vector<vec2>& Pi) {
+		double contourChange = 0.0;
+		for (unsigned int i = 0; i < Pi.size(); ++i)
+		{
+			double x = 0.0, y = 0.0;
+			for (unsigned int t = _termStart[i]; t < _termStart[i + 1]; t++)
+			{
+				x += _terms[t].weight * X[2 * _terms[t].unknown];
+				y += _terms[t].weight * X[2 * _terms[t].unknown + 1];
+			}
+			vec2 PiTarget = vec2(float(x), float(y));
+			contourChange = std::max(contourChange, double(glm::length(PiTarget - Pi[i])));
+			Pi[i] = PiTarget;
+		}
+		return contourChange;
+	};
+
+	std::vector<vec2> Pi = _PiInit;
+	bool fromIdentity = (X.size() != 2 * F);
+	if (fromIdentity)
+		X = _tree.identity();
+	else
+		advect(Pi);
+
+	unsigned int iterations = 0;
+	bool converged = false;
+	_convergence.clear();
+	double tolerance = _settings.irls_tolerance / R; // in texture space
+
+	for (unsigned int iter = 0; iter < NIterations && !converged; ++iter) {
+
+		auto iterationStart = std::chrono::steady_clock::now();
+
+		_system.clear();
+
+		double gaussKernelStd, pExponent, epsilonPrec;
+		_settings.data_term.at(iter, gaussKernelStd, pExponent, epsilonPrec);
+
+		unsigned int prunedEquations;
+		bool reusedDataTerm = (iter == 0 && fromIdentity && _identityDataTermCached);
+		if (reusedDataTerm)
+		{
+			_system.addBlock(_identityDataTerm);
+			prunedEquations = _identityPrunedEquations;
+		}
+		else
+		{
+			prunedEquations = addDataEquations(Pi, gaussKernelStd, pExponent, epsilonPrec);
+			if (iter == 0 && fromIdentity)
+			{
+				_identityDataTerm = _system.takeBlock();
+				_identityPrunedEquations = prunedEquations;
+				_identityDataTermCached = true;
+				_system.addBlock(_identityDataTerm);
+			}
+		}
+		_system.addBlock(_interiorRegularity, double(alpha) * alpha);
+		_system.addBlock(_periodicHarmonicity, double(beta) * beta);
+
+		Eigen::VectorXd Xprevious = X;
+
+		auto solveSystem = [&](unsigned int s, Eigen::VectorXd& Xs) {
+			_system.preprocess(s);
+			if (!_system.solve(s, Xs))
+				std::cout << "warning: " << _system.solver(s).name() << " failed for system " << s << std::endl;
+		};
+
+		if (decoupled)
+		{
+			Eigen::VectorXd Xc[2] = { Eigen::VectorXd(F), Eigen::VectorXd(F) };
+			for (unsigned int g = 0; g < F; ++g) {
+				Xc[0][g] = X[2 * g];
+				Xc[1][g] = X[2 * g + 1];
+			}
+
+			std::future<void> ySolve = std::async(std::launch::async, [&]() { solveSystem(1, Xc[1]); });
+			solveSystem(0, Xc[0]);
+			ySolve.get();
+
+			for (unsigned int g = 0; g < F; ++g) {
+				X[2 * g] = Xc[0][g];
+				X[2 * g + 1] = Xc[1][g];
+			}
+		}
+		else
+		{
+			solveSystem(0, X);
+		}
+
+		auto solved = std::chrono::steady_clock::now();
+
+		double gridChange = 0.0;
+		for (unsigned int g = 0; g < F; ++g)
+			gridChange = std::max(gridChange, std::hypot(X[2 * g] - Xprevious[2 * g], X[2 * g + 1] - Xprevious[2 * g + 1]));
+		double contourChange = advect(Pi);
+
+		std::cout << "Quadtree system solve: " << iter << "/" << NIterations - 1
+			<< " (" << (reusedDataTerm ? "reused data term" : "data term")
+			<< ", total " << std::chrono::duration<double>(solved - iterationStart).count() << " s)";
+		if (_settings.backend == SolverBackend::IncompleteCholeskyCG || _settings.backend == SolverBackend::LeastSquaresCG)
+			for (unsigned int s = 0; s < nsystems; s++)
+				std::cout << ", " << _system.solver(s).name() << " " << _system.solver(s).iterations() << " iterations";
+		if (_settings.weight_cutoff > 0.0)
+			std::cout << ", pruned " << prunedEquations << "/" << knn * Pi.size() << " data equations";
+		if (_settings.data_term.steps > 1)
+			std::cout << ", kernel " << gaussKernelStd << ", p " << pExponent << ", epsilon " << epsilonPrec;
+		std::cout << ", grid change " << gridChange << ", contour change " << contourChange << std::endl;
+
+		if (_settings.convergence)
+		{
+			irlsIteration it = { gaussKernelStd, pExponent, epsilonPrec, gridChange * R, contourChange * R,
+				mean_target_distance(Pi, _settings, _QGrid, _QKdtree) * R, std::chrono::duration<double>(solved - iterationStart).count() };
+			_convergence.push_back(it);
 		}
+
+		iterations = iter + 1;
+		converged = gridChange < tolerance && contourChange < tolerance && int(iterations) >= _settings.data_term.steps;
 	}
 
-	delete[] id_nearest_neighbors;
-	delete[] square_distances_to_neighbors;
+	if (converged)
+		std::cout << "IRLS converged after " << iterations << " iterations" << std::endl;
+	else
+		std::cout << "IRLS stopped after " << iterations << " iterations without reaching tolerance " << tolerance << std::endl;
+
+	return iterations;
+}
+
+// "_a<alpha>_b<beta>" to tell apart the outputs of a sweep
+static std::string sweep_suffix(float alpha, float beta)
+{
+	std::ostringstream suffix;
+	suffix << "_a" << alpha << "_b" << beta;
+	return suffix.str();
 }
 
+// appends the iterations of a level of grid size n to a convergence curve
+static void append_convergence(std::ostringstream& curve, unsigned int n, std::vector<irlsIteration> const& convergence)
+{
+	for (size_t it = 0; it < convergence.size(); it++)
+		curve << n << ", " << it << ", " << convergence[it].kernel << ", " << convergence[it].p << ", "
+			<< convergence[it].epsilon << ", " << convergence[it].gridChange << ", " << convergence[it].contourChange << ", "
+			<< convergence[it].meanDistance << ", " << convergence[it].seconds << std::endl;
+}
+
+// coarsest level of the adaptive warpgrid, 16x16 cells
+static const unsigned int quadtree_min_level = 4;
+
 void compute_and_serialize_warpgrid(
 	std::vector<vec2> const& P_xy,
 	std::vector<vec2> const& Q_xy,
 	Params const& cmd_inputs)
 {
-	// init system solution
-	Eigen::VectorXd X;
-	std::vector<vec2> P_xy_transformed;
+	unsigned int grid_size = cmd_inputs.grid_size;
+
+	// the (alpha,beta) pairs to solve, the outputs of a sweep get a suffix
+	bool sweep = !cmd_inputs.sweep.empty();
+	std::vector<std::pair<float, float>> weights = cmd_inputs.sweep;
+	if (!sweep)
+		weights.push_back(std::make_pair(float(cmd_inputs.alpha), float(cmd_inputs.beta)));
+
+	// pyramid levels, coarse to fine: each level starts from the upsampled grid of the previous one
+	std::vector<unsigned int> levels;
+	bool pyramid = cmd_inputs.pyramid_start > 0 && cmd_inputs.pyramid_start < cmd_inputs.grid_size;
+	if (pyramid)
+		for (unsigned int n = cmd_inputs.pyramid_start; n < grid_size; n *= 2)
+			levels.push_back(n);
+	levels.push_back(grid_size);
+
+	// one session per level, shared by all the (alpha,beta) pairs
+	std::vector<std::unique_ptr<warpgridSession>> sessions(levels.size());
+
+	// or the adaptive warpgrid, resampled to the grid_size warpgrid for the outputs
+	std::unique_ptr<quadtreeWarpgridSession> quadtree;
+	if (cmd_inputs.quadtree_level > 0)
+	{
+		if (pyramid)
+			std::cout << "the pyramid does not apply to the adaptive warpgrid, solving it directly" << std::endl;
+		unsigned int maxLevel = cmd_inputs.quadtree_level;
+		quadtree.reset(new quadtreeWarpgridSession(P_xy, Q_xy, std::min(quadtree_min_level, maxLevel), maxLevel,
+			cmd_inputs.quadtree_points, cmd_inputs.solver));
+		unsigned int finest = quadtree->tree().finestSize() + 1;
+		std::cout << "adaptive warpgrid: " << quadtree->tree().leafCount() << " leaves, " << quadtree->tree().unknownCount()
+			<< " vertices, finest cells of a " << finest << "x" << finest << " grid (" << finest * finest << " vertices)" << std::endl;
+	}
+
+	for (std::pair<float, float> const& w : weights)
+	{
+		auto sweepStart = std::chrono::steady_clock::now();
+
+		// init system solution
+		Eigen::VectorXd X;
+
+		// convergence curve of all the levels
+		std::ostringstream curve;
+		curve << "grid size, iteration, kernel, p, epsilon, grid change, contour change, mean target distance, seconds" << std::endl;
 
-	build_and_solve_linear_system(P_xy, Q_xy, X, cmd_inputs.grid_size, cmd_inputs.alpha, cmd_inputs.beta);
+		if (quadtree)
+		{
+			Eigen::VectorXd Xq;
+			quadtree->solve(Xq, w.first, w.second, cmd_inputs.iterations);
+			append_convergence(curve, quadtree->tree().finestSize() + 1, quadtree->convergence());
+			X = quadtree->tree().resample(Xq, grid_size);
+		}
+
+		for (size_t level = 0; level < levels.size() && !quadtree; level++)
+		{
+			auto start = std::chrono::steady_clock::now();
+
+			if (!sessions[level])
+				sessions[level].reset(new warpgridSession(P_xy, Q_xy, levels[level], cmd_inputs.solver));
+			if (level > 0)
+				X = upsample_warpgrid(X, levels[level - 1], levels[level]);
+
+			unsigned int iterations = sessions[level]->solve(X, w.first, w.second,
+				pyramid ? cmd_inputs.pyramid_iterations : cmd_inputs.iterations);
+
+			append_convergence(curve, levels[level], sessions[level]->convergence());
+
+			if (pyramid)
+				std::cout << "pyramid level " << levels[level] << "x" << levels[level] << " solved with " << iterations << " iterations in "
+					<< std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s" << std::endl;
+		}
 
-	std::string filename = "warp_" 
-		+ cmd_inputs.filename_P
-		+ "_" 
-		+ cmd_inputs.filename_Q 
-		+ ".png";
+		std::string suffix = cmd_inputs.output_suffix + (sweep ? sweep_suffix(w.first, w.second) : "");
+		if (sweep)
+			std::cout << "sweep alpha " << w.first << ", beta " << w.second << " solved in "
+				<< std::chrono::duration<double>(std::chrono::steady_clock::now() - sweepStart).count() << " s" << std::endl;
 
-	saveGridImage(X, filename, cmd_inputs.grid_size);
+		std::string filename = "warp_"
+			+ cmd_inputs.filename_P
+			+ "_"
+			+ cmd_inputs.filename_Q
+			+ suffix;
 
-	writeIntoFile(X, cmd_inputs.filename_P + "_" + cmd_inputs.filename_Q);
-}
\ No newline at end of file
+		if (cmd_inputs.images == VisualOutput::Raster)
+			saveGridImage(X, filename + ".png", cmd_inputs.grid_size);
+		else
+			save_polylines(cmd_inputs.images, filename, gridPolylines(X, cmd_inputs.grid_size), 1024, 1024, { 255, 0, 0 }, 1.0);
+
+		if (cmd_inputs.format != WarpgridFormat::Binary)
+			writeIntoFile(X, cmd_inputs.filename_P + "_" + cmd_inputs.filename_Q + suffix);
+		if (cmd_inputs.format != WarpgridFormat::Text)
+		{
+			std::vector<float> rg(X.data(), X.data() + X.size());
+			write_wgb("warp_" + cmd_inputs.filename_P + "_" + cmd_inputs.filename_Q + suffix + ".wgb", rg.data(), cmd_inputs.grid_size);
+		}
+
+		// distances and changes are in grid cells of each level
+		if (cmd_inputs.solver.convergence)
+		{
+			std::string curve_filename = "convergence_" + cmd_inputs.filename_P + "_" + cmd_inputs.filename_Q + suffix + ".csv";
+			std::ofstream curve_file(curve_filename);
+			if (curve_file.is_open())
+				curve_file << curve.str();
+			else
+				std::cerr << "could not write " << curve_filename << std::endl;
+		}
+	}
+}
@@ -3,9 +3,15 @@
 #include <vector>
 #include <string>
 #include <chrono>
+#include <future>
+#include <memory>
 
 #include "LinearSystem.h"
 #include "KDTree.h"
+#include "PeriodicGrid.h"
+#include "SampleElimination.h"
+#include "SparseSolver.h"
+#include "Quadtree.h"
 
 #include "WarpIO.h"
 #include "WarpUtils.h"
@@ -14,13 +20,125 @@ using std::vector;
 using std::cout;
 using std::endl;
 
-void build_and_solve_linear_system(
+// one IRLS iteration of a convergence curve
+struct irlsIteration {
+	double kernel, p, epsilon;  // data term parameters
+	double gridChange;          // largest displacement of a grid vertex, in grid cells
+	double contourChange;       // largest displacement of an advected contour point, in grid cells
+	double meanDistance;        // mean distance from the advected contour points to their closest target, in grid cells
+	double seconds;
+};
+
+// IRLS solver of the N*N warpgrids mapping the points PiInit onto Qj, for several (alpha,beta) pairs.
+// Everything that does not depend on alpha and beta is done once: the neighbor search index of Qj,
+// the grid cells of PiInit, the sparsity pattern and symbolic factorization of the normal equations,
+// the unit regularization terms, and the data term of the first iteration from the identity grid.
+class warpgridSession {
+	std::vector<vec2> _PiInit;
+	std::vector<vec2> _Qj;
+	unsigned int _N;
+	SolverSettings _settings;
+
+	BasicANNkdTree _QKdtree;
+	periodicPointGrid _QGrid;
+
+	std::vector<unsigned int> _cells;  // bilinear interpolation cells of PiInit
+	std::vector<float> _cellCoords;
+
+	linearSystem _system;
+	linearSystem::block _interiorRegularity;     // alpha = 1
+	linearSystem::block _periodicHarmonicity;    // beta = 1
+	linearSystem::block _identityDataTerm;       // data term of the identity grid
+	bool _identityDataTermCached = false;
+	unsigned int _identityPrunedEquations = 0;
+	double _symbolicTime = 0.0;                  // of the symbolic factorization, done at the first solve
+
+	bool _benchmarked = false;                   // the backends are benchmarked on the first system only
+
+	std::vector<irlsIteration> _convergence;
+
+	// adds the data equations of the current points Pi, returns the number of pruned equations
+	unsigned int addDataEquations(std::vector<vec2> const& Pi, double gaussKernelStd, double pExponent, double epsilonPrec);
+
+	// mean distance from the points Pi to their closest target
+	double meanTargetDistance(std::vector<vec2> const& Pi) const;
+
+	warpgridSession(warpgridSession const&) = delete;
+	warpgridSession& operator=(warpgridSession const&) = delete;
+
+public:
+	warpgridSession(std::vector<vec2> const& PiInit, std::vector<vec2> const& Qj,
+		unsigned int N, SolverSettings const& settings = SolverSettings());
+
+	unsigned int gridSize() const { return _N; }
+
+	// computes the warpgrid X for the given weights, if X already holds an N*N grid it is used
+	// as the starting point of the IRLS iterations, otherwise the identity grid.
+	// Iterates until the grid vertices and advected contour points move less than settings.irls_tolerance cells,
+	// at most NIterations times, and returns the number of iterations done
+	unsigned int solve(Eigen::VectorXd& X, float alpha, float beta, unsigned int NIterations = 10);
+
+	// the iterations of the last solve, recorded when settings.convergence is set
+	std::vector<irlsIteration> const& convergence() const { return _convergence; }
+};
+
+// IRLS solver of the adaptive warpgrid mapping the points PiInit onto Qj, see quadtreeWarpgrid.
+// The data term is the one of warpgridSession. The interior regularity term is the Laplacian of each
+// unknown with its neighbors at the size of the smallest leaf around it, interpolated in the leaves,
+// and the periodic harmonicity term ties each border unknown to the warp at the opposite border.
+// On a quadtree refined everywhere to 2^maxLevel cells, both are the equations of the uniform grid.
+// The multigrid backend needs a uniform grid: the adaptive warpgrid solves with cg instead
+class quadtreeWarpgridSession {
+	std::vector<vec2> _PiInit;
+	std::vector<vec2> _Qj;
+	quadtreeWarpgrid _tree;
+	SolverSettings _settings;
+
+	BasicANNkdTree _QKdtree;
+	periodicPointGrid _QGrid;
+
+	std::vector<unsigned int> _termStart;           // interpolation terms of PiInit[i] are [ _termStart[i] , _termStart[i+1] )
+	std::vector<quadtreeWarpgrid::term> _terms;
+
+	linearSystem _system;
+	linearSystem::block _interiorRegularity;        // alpha = 1
+	linearSystem::block _periodicHarmonicity;       // beta = 1
+	linearSystem::block _identityDataTerm;
+	bool _identityDataTermCached = false;
+	unsigned int _identityPrunedEquations = 0;
+
+	std::vector<irlsIteration> _convergence;
+
+	unsigned int addDataEquations(std::vector<vec2> const& Pi, double gaussKernelStd, double pExponent, double epsilonPrec);
+
+	quadtreeWarpgridSession(quadtreeWarpgridSession const&) = delete;
+	quadtreeWarpgridSession& operator=(quadtreeWarpgridSession const&) = delete;
+
+public:
+	// builds the quadtree of PiInit, refined from 2^minLevel to 2^maxLevel cells per side where the leaves hold more than maxPoints points
+	quadtreeWarpgridSession(std::vector<vec2> const& PiInit, std::vector<vec2> const& Qj,
+		unsigned int minLevel, unsigned int maxLevel, unsigned int maxPoints, SolverSettings const& settings = SolverSettings());
+
+	quadtreeWarpgrid const& tree() const { return _tree; }
+
+	// computes the warp X (interleaved x,y coordinates of the unknowns of the quadtree), see warpgridSession::solve.
+	// The tolerance is in cells of the finest level
+	unsigned int solve(Eigen::VectorXd& X, float alpha, float beta, unsigned int NIterations = 10);
+
+	std::vector<irlsIteration> const& convergence() const { return _convergence; }
+};
+
+// computes the N*N warpgrid X (interleaved x,y coordinates) mapping the points PiInit onto Qj,
+// see warpgridSession::solve, which should be preferred to solve the same points for several (alpha,beta)
+unsigned int build_and_solve_linear_system(
 	std::vector<vec2> const& PiInit,
 	std::vector<vec2> const& Qj,
 	Eigen::VectorXd& X,
 	unsigned int N, float alpha, float beta,
-	unsigned int NIterations = 10);
+	unsigned int NIterations = 10,
+	SolverSettings const& settings = SolverSettings());
 
+// solves and saves the warpgrid of cmd_inputs.alpha/beta, or of every pair of cmd_inputs.sweep
 void compute_and_serialize_warpgrid(
 	std::vector<vec2> const& P_xy,
 	std::vector<vec2> const& Q_xy,
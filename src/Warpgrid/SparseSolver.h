@@ -0,0 +1,211 @@
+#pragma once
+
+#include "Eigen/SparseCore"
+#include "Eigen/SparseCholesky"
+#include "Eigen/SparseLU"
+#include "Eigen/IterativeLinearSolvers"
+
+#include "Multigrid.h"
+
+#include <memory>
+
+// bytes held by a compressed sparse matrix
+inline size_t sparse_bytes( Eigen::SparseMatrix<double> const & M ) {
+    return size_t( M.nonZeros() ) * ( sizeof( double ) + sizeof( int ) ) + size_t( M.outerSize() + 1 ) * sizeof( int );
+}
+
+// Interchangeable solver of the systems of a linearSystem. Most backends solve the normal equations
+// AtA x = Atb, least squares backends solve min |A x - b|^2 directly on the equations A.
+// analyzePattern() is called once per sparsity pattern, factorize() each time the values change.
+class sparseSolver {
+public:
+    virtual ~sparseSolver() {}
+
+    virtual char const * name() const = 0;
+
+    // true when the solver takes the equations A and b rather than the normal equations AtA and Atb
+    virtual bool leastSquares() const { return false; }
+
+    virtual void analyzePattern( Eigen::SparseMatrix<double> const & M ) = 0;
+    virtual void factorize( Eigen::SparseMatrix<double> const & M ) = 0;
+
+    // solves for the right-hand side rhs, x holds the initial guess of the iterative solvers.
+    // Returns false when the factorization failed or the iterations did not converge
+    virtual bool solve( Eigen::VectorXd const & rhs , Eigen::VectorXd & x ) = 0;
+
+    // iterations and relative residual of the last solve, 0 for direct solvers
+    virtual unsigned int iterations() const { return 0; }
+    virtual double error() const { return 0.0; }
+
+    // bytes held by the factors, preconditioner or operators of the solver, besides the system itself
+    virtual size_t memory() const = 0;
+};
+
+// direct simplicial LDLT factorization of AtA
+class ldltSolver : public sparseSolver {
+    Eigen::SimplicialLDLT< Eigen::SparseMatrix<double> > _ldlt;
+
+public:
+    char const * name() const { return "ldlt"; }
+    void analyzePattern( Eigen::SparseMatrix<double> const & M ) { _ldlt.analyzePattern( M ); }
+    void factorize( Eigen::SparseMatrix<double> const & M ) { _ldlt.factorize( M ); }
+    bool solve( Eigen::VectorXd const & rhs , Eigen::VectorXd & x ) {
+        x = _ldlt.solve( rhs );
+        return _ldlt.info() == Eigen::Success;
+    }
+    size_t memory() const {
+        return sparse_bytes( _ldlt.matrixL().nestedExpression() ) + size_t( _ldlt.vectorD().size() ) * sizeof( double )
+            + size_t( _ldlt.permutationP().size() ) * 2 * sizeof( int );
+    }
+};
+
+// LDLT factorization of AtA in single precision, refined in double precision. The factor takes half the memory
+// and bandwidth of the double one. Plain iterative refinement x += solve( b - AtA x ) only gains a factor
+// condition number * float precision per step, which is slow on the ill-conditioned warpgrid systems: the
+// refinement steps are rather conjugate gradient iterations preconditioned by the float factorization, which
+// cost the same but converge much faster. They stop at the relative residual tolerance, or after maxSteps
+class mixedLDLTSolver : public sparseSolver {
+    Eigen::SimplicialLDLT< Eigen::SparseMatrix<float> > _ldlt;
+    Eigen::SparseMatrix<double> const * _doubleM = nullptr;   // for the residuals, must outlive the solves
+    double _tolerance;
+    unsigned int _maxSteps;
+    unsigned int _steps = 0;
+    double _error = 0.0;
+
+    Eigen::VectorXd floatSolve( Eigen::VectorXd const & rhs ) const {
+        Eigen::VectorXf rhsf = rhs.cast<float>();
+        return _ldlt.solve( rhsf ).cast<double>();
+    }
+
+public:
+    mixedLDLTSolver( double tolerance , unsigned int maxSteps ) : _tolerance( tolerance ) , _maxSteps( maxSteps ) {}
+    char const * name() const { return "ldlt-mixed"; }
+    void analyzePattern( Eigen::SparseMatrix<double> const & M ) { _ldlt.analyzePattern( Eigen::SparseMatrix<float>( M.cast<float>() ) ); }
+    void factorize( Eigen::SparseMatrix<double> const & M ) {
+        _ldlt.factorize( Eigen::SparseMatrix<float>( M.cast<float>() ) );
+        _doubleM = &M;
+    }
+    bool solve( Eigen::VectorXd const & rhs , Eigen::VectorXd & x ) {
+        if( _ldlt.info() != Eigen::Success ) return false;
+        Eigen::SparseMatrix<double> const & M = *_doubleM;
+        double rhsNorm = rhs.norm();
+
+        x = floatSolve( rhs );
+        Eigen::VectorXd r = rhs - M * x;
+        Eigen::VectorXd z = floatSolve( r );
+        Eigen::VectorXd p = z , Mp;
+        double rz = r.dot( z );
+
+        _steps = 0;
+        _error = rhsNorm > 0.0 ? r.norm() / rhsNorm : 0.0;
+        while( _error > _tolerance && _steps < _maxSteps ) {
+            Mp = M * p;
+            double step = rz / p.dot( Mp );
+            x += step * p;
+            r -= step * Mp;
+            ++_steps;
+            _error = r.norm() / rhsNorm;
+
+            z = floatSolve( r );
+            double rzNext = r.dot( z );
+            p = z + ( rzNext / rz ) * p;
+            rz = rzNext;
+        }
+        return _error <= _tolerance;
+    }
+    unsigned int iterations() const { return _steps; }
+    double error() const { return _error; }
+    size_t memory() const {
+        Eigen::SparseMatrix<float> const & L = _ldlt.matrixL().nestedExpression();
+        return size_t( L.nonZeros() ) * ( sizeof( float ) + sizeof( int ) ) + size_t( L.outerSize() + 1 ) * sizeof( int )
+            + size_t( _ldlt.vectorD().size() ) * sizeof( float ) + size_t( _ldlt.permutationP().size() ) * 2 * sizeof( int )
+            + 5 * size_t( L.cols() ) * sizeof( double );
+    }
+};
+
+// direct supernodal LU factorization of AtA, with a COLAMD ordering
+class sparseLUSolver : public sparseSolver {
+    Eigen::SparseLU< Eigen::SparseMatrix<double> , Eigen::COLAMDOrdering<int> > _lu;
+
+public:
+    char const * name() const { return "lu"; }
+    void analyzePattern( Eigen::SparseMatrix<double> const & M ) { _lu.analyzePattern( M ); }
+    void factorize( Eigen::SparseMatrix<double> const & M ) { _lu.factorize( M ); }
+    bool solve( Eigen::VectorXd const & rhs , Eigen::VectorXd & x ) {
+        if( _lu.info() != Eigen::Success ) return false;
+        x = _lu.solve( rhs );
+        return true;
+    }
+    size_t memory() const {
+        return size_t( _lu.nnzL() + _lu.nnzU() ) * ( sizeof( double ) + sizeof( int ) )
+            + size_t( _lu.rowsPermutation().size() + _lu.colsPermutation().size() ) * sizeof( int );
+    }
+};
+
+// conjugate gradient on AtA preconditioned by an incomplete Cholesky factorization
+class incompleteCholeskyCGSolver : public sparseSolver {
+    Eigen::ConjugateGradient< Eigen::SparseMatrix<double> , Eigen::Lower | Eigen::Upper , Eigen::IncompleteCholesky<double> > _cg;
+
+public:
+    incompleteCholeskyCGSolver( double tolerance , unsigned int maxIterations ) {
+        _cg.setTolerance( tolerance );
+        _cg.setMaxIterations( maxIterations );
+    }
+    char const * name() const { return "cg"; }
+    void analyzePattern( Eigen::SparseMatrix<double> const & M ) { _cg.analyzePattern( M ); }
+    void factorize( Eigen::SparseMatrix<double> const & M ) { _cg.factorize( M ); }
+    bool solve( Eigen::VectorXd const & rhs , Eigen::VectorXd & x ) {
+        x = _cg.solveWithGuess( rhs , x );
+        return _cg.info() == Eigen::Success;
+    }
+    unsigned int iterations() const { return (unsigned int)_cg.iterations(); }
+    double error() const { return _cg.error(); }
+    size_t memory() const {
+        // the factor, and the residual, direction, preconditioned residual and product vectors
+        return sparse_bytes( _cg.preconditioner().matrixL() ) + 4 * size_t( _cg.cols() ) * sizeof( double );
+    }
+};
+
+// conjugate gradient on the least squares problem min |A x - b|^2 itself, preconditioned
+// by the inverse squared column norms of A: AtA is only applied as At (A x)
+class leastSquaresCGSolver : public sparseSolver {
+    Eigen::LeastSquaresConjugateGradient< Eigen::SparseMatrix<double> > _lscg;
+
+public:
+    leastSquaresCGSolver( double tolerance , unsigned int maxIterations ) {
+        _lscg.setTolerance( tolerance );
+        _lscg.setMaxIterations( maxIterations );
+    }
+    char const * name() const { return "lscg"; }
+    bool leastSquares() const { return true; }
+    void analyzePattern( Eigen::SparseMatrix<double> const & M ) { _lscg.analyzePattern( M ); }
+    void factorize( Eigen::SparseMatrix<double> const & M ) { _lscg.factorize( M ); }
+    bool solve( Eigen::VectorXd const & rhs , Eigen::VectorXd & x ) {
+        x = _lscg.solveWithGuess( rhs , x );
+        return _lscg.info() == Eigen::Success;
+    }
+    unsigned int iterations() const { return (unsigned int)_lscg.iterations(); }
+    double error() const { return _lscg.error(); }
+    size_t memory() const {
+        // the diagonal preconditioner, and the work vectors of the columns and rows sizes
+        return 4 * size_t( _lscg.cols() ) * sizeof( double ) + 2 * size_t( _lscg.rows() ) * sizeof( double );
+    }
+};
+
+// conjugate gradient on AtA preconditioned by a geometric multigrid V-cycle of the warpgrid, see multigridPCG
+class multigridSolver : public sparseSolver {
+    multigridPCG _multigrid;
+
+public:
+    multigridSolver( unsigned int N , unsigned int components , double tolerance , unsigned int maxIterations ) : _multigrid( N , components ) {
+        _multigrid.setTolerance( tolerance );
+        _multigrid.setMaxIterations( maxIterations );
+    }
+    char const * name() const { return "pcg"; }
+    void analyzePattern( Eigen::SparseMatrix<double> const & ) {}
+    void factorize( Eigen::SparseMatrix<double> const & M ) { _multigrid.compute( M ); }
+    bool solve( Eigen::VectorXd const & rhs , Eigen::VectorXd & x ) { return _multigrid.solve( rhs , x ); }
+    unsigned int iterations() const { return _multigrid.iterations(); }
+    double error() const { return _multigrid.error(); }
+    size_t memory() const { return _multigrid.memory(); }
+};
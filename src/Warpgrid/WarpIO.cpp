@@ -11,6 +11,8 @@ void writeIntoFile(
     myfile.open(filename);
     if (myfile.is_open())
     {
+        // all the digits of the doubles, the default precision of 6 digits is below a texel of a 4K map
+        myfile << std::setprecision(std::numeric_limits<double>::max_digits10);
         myfile << nb_pts << "\n";
         for (int i = 0; i < nb_pts; i++)
         {
@@ -82,3 +84,22 @@ void saveGridImage(
 
     image.mirrored(false, true).save(QString::fromStdString(filename));
 }
+
+contourCurves gridPolylines(
+    Eigen::VectorXd const& G,
+    int N, int width, int height)
+{
+    contourCurves curves;
+    for (int line = 0; line < 2 * N; line++)
+    {
+        for (int i = 0; i < N; i++)
+        {
+            int k = line < N ? i : line - N;    // rows, then columns
+            int l = line < N ? line : i;
+            curves.x.push_back(width * G[2 * (k + l * N)]);
+            curves.y.push_back(height * G[2 * (k + l * N) + 1]);
+        }
+        curves.curve_limits.push_back(curves.points());
+    }
+    return curves;
+}
@@ -2,6 +2,8 @@
 
 #include <iostream>
 #include <fstream>
+#include <iomanip>
+#include <limits>
 
 #include <QImage>
 #include <QPainter>
@@ -30,6 +32,11 @@ void saveGridImage(
     int N, int width = 1024, int height = 1024,
     QImage::Format format = QImage::Format_RGB32);
 
+// the rows and columns of the N*N warpgrid G as polylines, in pixels of a width*height image
+contourCurves gridPolylines(
+    Eigen::VectorXd const& G,
+    int N, int width = 1024, int height = 1024);
+
 template< class point_t >
 void savePointSetImage(
     std::vector<point_t> const& P,
@@ -28,6 +28,7 @@ void write_warpgrid(const char* fname_in, const vector<vector<vec2>>& warp_in)
 
     if (myfile.is_open())
     {
+        myfile << std::setprecision(std::numeric_limits<float>::max_digits10);
         myfile << nb_pts << "\n";
         for (int i = 0; i < height; i++)
         {
@@ -108,6 +109,41 @@ void saveGridImage(
     image.mirrored(false, true).save(QString::fromStdString(filename));
 }
 
+contourCurves gridPolylines(
+    vector<vector<vec2>> const& G,
+    int N)
+{
+    float width = 4096, height = 4096, margin = 0.05f * width;
+
+    contourCurves curves;
+    auto add = [&](float x, float y) {
+        curves.x.push_back(width * x + margin);
+        curves.y.push_back(height * y + margin);
+    };
+
+    for (int l = 0; l < N; l++)
+    {
+        for (int k = 0; k < N; k++) add(G[k][l].x, G[k][l].y);
+        curves.curve_limits.push_back(curves.points());
+    }
+    for (int k = 0; k < N; k++)
+    {
+        for (int l = 0; l < N; l++) add(G[k][l].x, G[k][l].y);
+        curves.curve_limits.push_back(curves.points());
+    }
+    for (int d = 2 - N; d < N - 1; d++)
+    {
+        for (int k = std::max(0, d); k < std::min(N, N + d); k++) add(G[k][k - d].x, G[k][k - d].y);
+        curves.curve_limits.push_back(curves.points());
+    }
+
+    // frame
+    float corners[5][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 }, { 0, 0 } };
+    for (auto const& c : corners) add(c[0], c[1]);
+    curves.curve_limits.push_back(curves.points());
+    return curves;
+}
+
 void saveGridImage_test(
     std::vector<vec2> const& neigh,
     vector<vector<vec2>> const& G,
@@ -304,7 +340,7 @@ vector<vector<vec2>> resize_final_warpgrid(const vector<vector<vec2>>& warp_in)
     return vector<vector<vec2>>();
 }
 
-bool computeWarpgridTextureDesign(string fname_in, string fname_in_2, float alpha, int output_size)
+bool computeWarpgridTextureDesign(string fname_in, string fname_in_2, float alpha, int output_size, VisualOutput grid_output)
 {
     stbi_set_flip_vertically_on_load(true);
 
@@ -430,8 +466,11 @@ bool computeWarpgridTextureDesign(string fname_in, string fname_in_2, float alph
     std::string name = "warp_TD_" + path1.stem().string() + "_" + path2.stem().string() + "_" + alpha_str + ".txt";
     write_warpgrid(name.c_str(), warp_grid);
 
-    std::string namepng = "warp_TD_" + path1.stem().string() + "_" + path2.stem().string() + "_" + alpha_str + ".png";
-    saveGridImage(warp_grid, namepng, grid_scale);
+    std::string namegrid = "warp_TD_" + path1.stem().string() + "_" + path2.stem().string() + "_" + alpha_str;
+    if (grid_output == VisualOutput::Raster)
+        saveGridImage(warp_grid, namegrid + ".png", grid_scale);
+    else
+        save_polylines(grid_output, namegrid, gridPolylines(warp_grid, grid_scale), int(1.1f * 4096), int(1.1f * 4096), { 255, 0, 0 }, 1.0);
 
     stbi_image_free(F0);
     stbi_image_free(F1);
@@ -5,6 +5,7 @@
 #include <fstream>
 #include <iostream>
 #include <iomanip>
+#include <limits>
 #include <filesystem>
 
 #include <QColor>
@@ -38,13 +39,19 @@ void saveGridImage(
     std::string const& filename,
     int N);
 
+// the rows, columns and diagonals of the N*N warpgrid G and the frame of the texture as polylines,
+// in pixels of the image of saveGridImage
+contourCurves gridPolylines(
+    vector<vector<vec2>> const& G,
+    int N);
+
 void saveGridImage_test(
     std::vector<vec2> const& neigh,
     vector<vector<vec2>> const& G,
     std::string const& filename,
     int N);
 
-bool computeWarpgridTextureDesign(string fname_in, string fname_in_2, float alpha, int output_size);
+bool computeWarpgridTextureDesign(string fname_in, string fname_in_2, float alpha, int output_size, VisualOutput grid_output = VisualOutput::Raster);
 
 vector<vector<vec2>> get_padded_warpgrid(const vector<vector<vec2>>& warpgrid);
 
@@ -59,3 +59,83 @@ vec2 get_grid_cell(int coord, unsigned int N)
     int x_coord = coord % N;
     return vec2(float(x_coord) / float(N - 1), float(y_coord) / float(N - 1));
 }
+
+
+vector<vector<vec2>> get_padded_warpgrid(Eigen::VectorXd const& G, unsigned int N)
+{
+    auto vertex = [&](unsigned int k, unsigned int l) { return vec2(G[2 * (k + l * N)], G[2 * (k + l * N) + 1]); };
+
+    // the periodic neighbours of the first and last vertices are N-2 and 1,
+    // as in the interior regularity term of the solver
+    size_t padding = 1;
+    vector<vector<vec2>> warp_out(N + 2 * padding, vector<vec2>(N + 2 * padding, vec2(0, 0)));
+
+    // corners
+    warp_out[0][0] = vertex(N - 2, N - 2) - vec2(1.0, 1.0);
+    warp_out[0][N + padding] = vertex(1, N - 2) + vec2(1.0, -1.0);
+    warp_out[N + padding][0] = vertex(N - 2, 1) + vec2(-1.0, 1.0);
+    warp_out[N + padding][N + padding] = vertex(1, 1) + vec2(1.0, 1.0);
+
+    //center
+    for (unsigned int l = 0; l < N; l++)
+        for (unsigned int k = 0; k < N; k++)
+            warp_out[l + padding][k + padding] = vertex(k, l);
+
+    //lines
+    for (unsigned int k = 0; k < N; k++)
+    {
+        warp_out[0][k + padding] = vertex(k, N - 2) - vec2(0.0, 1.0);
+        warp_out[N + padding][k + padding] = vertex(k, 1) + vec2(0.0, 1.0);
+    }
+
+    //columns
+    for (unsigned int l = 0; l < N; l++)
+    {
+        warp_out[l + padding][0] = vertex(N - 2, l) - vec2(1.0, 0.0);
+        warp_out[l + padding][N + padding] = vertex(1, l) + vec2(1.0, 0.0);
+    }
+
+    return warp_out;
+}
+
+Eigen::VectorXd upsample_warpgrid(Eigen::VectorXd const& G, unsigned int N, unsigned int M)
+{
+    vector<vector<vec2>> padded_warp_grid = get_padded_warpgrid(G, N);
+
+    Eigen::VectorXd warp_out(2 * M * M);
+    for (unsigned int l = 0; l < M; l++)
+    {
+        for (unsigned int k = 0; k < M; k++)
+        {
+            // vertex (k,l) of the fine grid in padded coarse grid coordinates
+            float x = 1.0f + k * (N - 1.0f) / (M - 1.0f);
+            float y = 1.0f + l * (N - 1.0f) / (M - 1.0f);
+            int xi = std::min(int(std::floor(x)), int(N));
+            int yi = std::min(int(std::floor(y)), int(N));
+            float xf = x - xi;
+            float yf = y - yi;
+
+            vec2 p = (1 - xf) * (1 - yf) * padded_warp_grid[yi][xi]
+                + xf * (1 - yf) * padded_warp_grid[yi][xi + 1]
+                + (1 - xf) * yf * padded_warp_grid[yi + 1][xi]
+                + xf * yf * padded_warp_grid[yi + 1][xi + 1];
+
+            warp_out[2 * (k + l * M)] = p[0];
+            warp_out[2 * (k + l * M) + 1] = p[1];
+        }
+    }
+
+    return warp_out;
+}
+
+vec2 warp_point(Eigen::VectorXd const& G, vec2 xy, unsigned int N)
+{
+    std::vector<int> grid_coords;
+    float u, v;
+    get_bilinear_interpolation(grid_coords, u, v, xy, N);
+
+    return (1 - u) * (1 - v) * vec2(G[2 * grid_coords[0]], G[2 * grid_coords[0] + 1]) +
+        u * (1 - v) * vec2(G[2 * grid_coords[1]], G[2 * grid_coords[1] + 1]) +
+        (1 - u) * v * vec2(G[2 * grid_coords[2]], G[2 * grid_coords[2] + 1]) +
+        u * v * vec2(G[2 * grid_coords[3]], G[2 * grid_coords[3] + 1]);
+}
\ No newline at end of file
@@ -6,8 +6,13 @@
 #include "stb_image.h"
 
 #include "Mat2.h"
+#include "Utils/PolylineOutput.h"
+#include "Utils/Parallel.h"
 
 #include <vector>
+#include <utility>
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 using glm::vec2;
@@ -105,6 +110,72 @@ private:
     int nbChannels = 0;
 };
 
+// how the x and y coordinates of the warpgrid are laid out in the linear system
+enum class SolverLayout {
+    Interleaved,    // a single 2N^2 system, x and y unknowns interleaved
+    Decoupled       // two independent N^2 systems, one per coordinate
+};
+
+// sparse solver used at each IRLS iteration
+enum class SolverBackend {
+    LDLT,                   // direct simplicial LDLT factorization
+    SparseLU,               // direct supernodal LU factorization
+    IncompleteCholeskyCG,   // conjugate gradient preconditioned by an incomplete Cholesky factorization
+    LeastSquaresCG,         // conjugate gradient on the equations rather than the normal equations
+    MultigridPCG            // conjugate gradient preconditioned by a geometric multigrid V-cycle
+};
+
+// spatial index used to find the target points closest to each contour point
+enum class NeighborSearch {
+    PeriodicGrid,   // uniform grid on the torus, a point near u=0 can match a target near u=1
+    KdTree          // ANN kd-tree, not periodic
+};
+
+// parameters of the data term weight exp(-d^2 / kernel) * (d^2 + epsilon)^((p - 2) / 2), annealed from their
+// start to their end values over the first steps IRLS iterations: geometrically for kernel and epsilon,
+// linearly for p. A wide kernel first matches the contours coarsely, the narrow one then refines them
+struct DataTermSchedule
+{
+    double kernel_start = 0.001, kernel_end = 0.001;
+    double p_start = 0.1, p_end = 0.1;
+    double epsilon_start = 0.001, epsilon_end = 0.001;
+    int steps = 0;                      // 0 or 1: the end values at every iteration
+
+    void at(unsigned int iteration, double& kernel, double& p, double& epsilon) const
+    {
+        double t = (steps > 1) ? std::min(1.0, iteration / (steps - 1.0)) : 1.0;
+        kernel = kernel_start * std::pow(kernel_end / kernel_start, t);
+        p = p_start + (p_end - p_start) * t;
+        epsilon = epsilon_start * std::pow(epsilon_end / epsilon_start, t);
+    }
+};
+
+struct SolverSettings
+{
+    SolverLayout layout = SolverLayout::Decoupled;
+    SolverBackend backend = SolverBackend::LDLT;
+    NeighborSearch neighbors = NeighborSearch::PeriodicGrid;
+    double weight_cutoff = 0.0;         // data equations weighted less than this fraction of the largest weight are pruned
+    double pcg_tolerance = 1e-8;        // relative residual of the iterative backends
+    int pcg_max_iterations = 500;
+    bool mixed_precision = false;       // single precision LDLT factorization refined in double precision
+    double refinement_tolerance = 1e-12; // relative residual at which the refinement of the mixed precision LDLT stops
+    int refinement_steps = 20;          // at most
+    bool benchmark = false;             // also solves the first system with every backend and reports their time and memory
+    double irls_tolerance = 0.25;       // largest vertex and contour point displacement, in grid cells
+    DataTermSchedule data_term;
+    bool convergence = false;           // records the convergence curve of the IRLS iterations
+    unsigned int threads = hardware_threads(); // of the parallel neighbor searches
+};
+
+// files of the solved warpgrid: text warp_*.txt and/or binary warp_*.wgb (see WarpgridFile.h)
+enum class WarpgridFormat
+{
+    Text,
+    Binary,
+    Both
+};
+
 struct Params
 {
 	std::string filename_P;
@@ -114,6 +185,20 @@ struct Params
     int grid_size = 0;
     int alpha = 0;
     int beta = 0;
+    SolverSettings solver;
+    int iterations = 10;            // IRLS iterations of a direct solve
+    int pyramid_start = 0;          // size of the coarsest pyramid level, 0 to solve directly at grid_size
+    int pyramid_iterations = 3;     // IRLS iterations per pyramid level
+    int sample_budget = 0;          // contour points kept by sample elimination, 0 for no budget
+    float sample_spacing = 0.0f;    // or minimum distance between the kept contour points, 0 to keep them all
+    std::vector<std::pair<float, float>> sweep; // (alpha,beta) pairs solved instead of alpha and beta, sharing the setup
+    int quadtree_level = 0;         // finest level of the adaptive warpgrid (2^level cells per side), 0 for the uniform grid
+    int quadtree_points = 16;       // contour points above which a cell of the adaptive warpgrid is split
+    int contour_resolution = 1024;  // size the maps are resampled to for the contour extraction, 0 for their native size
+    std::string contour_cache;      // directory of the contour cache, empty for no cache
+    VisualOutput images = VisualOutput::Raster; // visualization of the warpgrid and of the contours
+    WarpgridFormat format = WarpgridFormat::Text;
+    std::string output_suffix;      // appended to the names of the outputs, after mat1_mat2
 };
 
 struct pointFeature {
@@ -154,3 +239,15 @@ double WendlandKernel(double r, double h);
 void get_bilinear_interpolation(std::vector<int>& grid_coords, float& lambda, float& mu, vec2 xy, unsigned int N);
 
 vec2 get_grid_cell(int coord, unsigned int N);
+
+// solver warpgrids are stored as 2*N*N interleaved x,y coordinates, and their first and
+// last rows (resp. columns) overlap on the torus: vertex N-1 is vertex 0 shifted by one period
+
+// pads the N*N solver warpgrid G with one periodic ring of vertices, returned as (N+2)*(N+2) rows
+vector<vector<vec2>> get_padded_warpgrid(Eigen::VectorXd const& G, unsigned int N);
+
+// bilinearly resamples the N*N solver warpgrid G into an M*M one
+Eigen::VectorXd upsample_warpgrid(Eigen::VectorXd const& G, unsigned int N, unsigned int M);
+
+// position of the point xy through the N*N solver warpgrid G
+vec2 warp_point(Eigen::VectorXd const& G, vec2 xy, unsigned int N);
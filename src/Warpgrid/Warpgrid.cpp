@@ -1,8 +1,13 @@
 #include "Warpgrid.h"
 #include "Utils/Contours.h"
+#include "Utils/Parallel.h"
 
 #include <iomanip>
 #include <sstream>
+#include <map>
+#include <set>
+#include <limits>
+#include <type_traits>
 
 Warpgrid::Warpgrid(int argc, char* argv[], WarpgridType t) : nvertices(0), nfaces(0), nedges(0)
 {
@@ -13,54 +18,359 @@ Warpgrid::Warpgrid(int argc, char* argv[], WarpgridType t) : nvertices(0), nface
         loaded = computeWarpgridFromMaps(argc, argv);
         break;
     case WarpgridType::OpenFromFile:
-        loaded = loadTxtFile(argv[0]);
+        loaded = loadFile(argv[0]);
         break;
     default:
         break;
     }
 }
 
-bool Warpgrid::loadTxtFile(const std::string & filename)
+bool Warpgrid::loadFile(const std::string & filename)
 {
-    // 0 - open input file
-    std::ifstream infile(filename);
-    if (!infile.is_open())
+    if (is_wgb_filename(filename))
     {
-        std::cerr << "failed to open the file: " << filename << std::endl;
-        return false;
+        if (!mapped.open(filename))
+            return false;
+        nvertices = (unsigned int)mapped.vertexCount();
     }
-
-    // 1 - number of vertices
-    std::string info;
-    if (!get_next_uncommented_line(infile, info))
+    else
     {
-        return false;
+        if (!read_warpgrid_txt(filename, pointsData))
+            return false;
+        nvertices = (unsigned int)(pointsData.size() / 2);
     }
-    std::istringstream info_stream;
-    info_stream.str(info);
-
-    info_stream >> nvertices;
 
     if(nvertices != 0) {
         std::cout << "nb of vertices of the warp grid: " << int(sqrt(nvertices)) << "x" << int(sqrt(nvertices)) << std::endl;
     }
 
-    pointsData.reserve(2 * size_t(nvertices));
-    for (unsigned int i = 0; i < nvertices; ++i)
+    return true;
+}
+
+int Warpgrid::convertWarpgridFile(int argc, char* argv[])
+{
+    if (argc != 4)
     {
-        if (!get_next_uncommented_line(infile, info))
+        std::cerr << "usage: convert input output" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::string in = argv[2], out = argv[3];
+
+    std::vector<float> text;
+    mappedWarpgrid binary;
+    const float* rg;
+    size_t vertices;
+    if (is_wgb_filename(in))
+    {
+        if (!binary.open(in))
+            return EXIT_FAILURE;
+        rg = binary.data();
+        vertices = binary.vertexCount();
+    }
+    else
+    {
+        if (!read_warpgrid_txt(in, text))
+            return EXIT_FAILURE;
+        rg = text.data();
+        vertices = text.size() / 2;
+    }
+
+    bool written;
+    if (is_wgb_filename(out))
+    {
+        unsigned int N = (unsigned int)std::lround(std::sqrt(double(vertices)));
+        if (size_t(N) * N != vertices)
         {
-            return false;
+            std::cerr << "a .wgb warpgrid is square, " << in << " has " << vertices << " vertices" << std::endl;
+            return EXIT_FAILURE;
         }
-        std::istringstream info_stream(info);
-        glm::vec2 point;
-        info_stream >> point.x >> point.y;
-        pointsData.emplace_back(point.x);
-        pointsData.emplace_back(point.y);
+        written = write_wgb(out, rg, N);
+    }
+    else
+    {
+        written = write_warpgrid_txt(out, rg, vertices);
     }
 
-    infile.close();
+    if (!written)
+        return EXIT_FAILURE;
+    std::cout << "converted " << vertices << " vertices from " << in << " to " << out << std::endl;
+    return EXIT_SUCCESS;
+}
 
+// parses the whole text as the number of an option, in [min, max]: false with an error otherwise
+template<class T>
+static bool parseOptionValue(std::string const& option, std::string const& text, T& value,
+    T min = std::numeric_limits<T>::lowest(), T max = std::numeric_limits<T>::max())
+{
+    size_t end = 0;
+    try
+    {
+        if constexpr (std::is_integral<T>::value)
+            value = T(std::stoi(text, &end));
+        else
+            value = T(std::stod(text, &end));
+    }
+    catch (std::exception const&)
+    {
+        end = 0;
+    }
+    if (end == 0 || end != text.size())
+    {
+        std::cerr << "invalid value for option " << option << ": " << text << std::endl;
+        return false;
+    }
+    if (!(value >= min && value <= max))
+    {
+        if (max == std::numeric_limits<T>::max())
+            std::cerr << "the " << option << " value must be at least " << min << ", got: " << text << std::endl;
+        else
+            std::cerr << "the " << option << " value must be between " << min << " and " << max << ", got: " << text << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// parses "start:end", or a single value for both
+static bool parseScheduleRange(std::string const& option, std::string const& value, double& start, double& end)
+{
+    size_t colon = value.find(':');
+    if (!parseOptionValue(option, value.substr(0, colon), start))
+        return false;
+    if (colon == std::string::npos)
+    {
+        end = start;
+        return true;
+    }
+    return parseOptionValue(option, value.substr(colon + 1), end);
+}
+
+// parses the optional "-name value" pairs following the positional arguments
+static bool parseWarpgridOptions(int argc, char* argv[], int first, Params& cmd_inputs)
+{
+    for (int i = first; i < argc; i += 2)
+    {
+        std::string option = argv[i];
+        if (i + 1 >= argc)
+        {
+            std::cerr << "missing value for option " << option << std::endl;
+            return false;
+        }
+        std::string value = argv[i + 1];
+
+        if (option == "-layout")
+        {
+            if (value == "interleaved")
+                cmd_inputs.solver.layout = SolverLayout::Interleaved;
+            else if (value == "decoupled")
+                cmd_inputs.solver.layout = SolverLayout::Decoupled;
+            else
+            {
+                std::cerr << "unknown solver layout: " << value << std::endl;
+                return false;
+            }
+        }
+        else if (option == "-solver")
+        {
+            if (value == "ldlt")
+                cmd_inputs.solver.backend = SolverBackend::LDLT;
+            else if (value == "lu")
+                cmd_inputs.solver.backend = SolverBackend::SparseLU;
+            else if (value == "cg")
+                cmd_inputs.solver.backend = SolverBackend::IncompleteCholeskyCG;
+            else if (value == "lscg")
+                cmd_inputs.solver.backend = SolverBackend::LeastSquaresCG;
+            else if (value == "pcg")
+                cmd_inputs.solver.backend = SolverBackend::MultigridPCG;
+            else
+            {
+                std::cerr << "unknown solver: " << value << std::endl;
+                return false;
+            }
+        }
+        else if (option == "-knn")
+        {
+            if (value == "grid")
+                cmd_inputs.solver.neighbors = NeighborSearch::PeriodicGrid;
+            else if (value == "kdtree")
+                cmd_inputs.solver.neighbors = NeighborSearch::KdTree;
+            else
+            {
+                std::cerr << "unknown neighbor search: " << value << std::endl;
+                return false;
+            }
+        }
+        else if (option == "-weight_cutoff")
+        {
+            if (!parseOptionValue(option, value, cmd_inputs.solver.weight_cutoff, 0.0, 1.0))
+                return false;
+        }
+        else if (option == "-precision")
+        {
+            if (value == "double")
+                cmd_inputs.solver.mixed_precision = false;
+            else if (value == "mixed")
+                cmd_inputs.solver.mixed_precision = true;
+            else
+            {
+                std::cerr << "unknown precision: " << value << std::endl;
+                return false;
+            }
+        }
+        else if (option == "-benchmark")
+        {
+            int benchmark;
+            if (!parseOptionValue(option, value, benchmark))
+                return false;
+            cmd_inputs.solver.benchmark = (benchmark != 0);
+        }
+        else if (option == "-pcg_tolerance")
+        {
+            if (!parseOptionValue(option, value, cmd_inputs.solver.pcg_tolerance))
+                return false;
+            if (!(cmd_inputs.solver.pcg_tolerance > 0.0))
+            {
+                std::cerr << "the -pcg_tolerance must be positive, got: " << value << std::endl;
+                return false;
+            }
+        }
+        else if (option == "-tolerance")
+        {
+            if (!parseOptionValue(option, value, cmd_inputs.solver.irls_tolerance, 0.0))
+                return false;
+        }
+        else if (option == "-kernel")
+        {
+            if (!parseScheduleRange(option, value, cmd_inputs.solver.data_term.kernel_start, cmd_inputs.solver.data_term.kernel_end))
+                return false;
+            if (!(cmd_inputs.solver.data_term.kernel_start > 0.0 && cmd_inputs.solver.data_term.kernel_end > 0.0))
+            {
+                std::cerr << "the -kernel values must be positive, got: " << value << std::endl;
+                return false;
+            }
+        }
+        else if (option == "-p")
+        {
+            if (!parseScheduleRange(option, value, cmd_inputs.solver.data_term.p_start, cmd_inputs.solver.data_term.p_end))
+                return false;
+        }
+        else if (option == "-epsilon")
+        {
+            if (!parseScheduleRange(option, value, cmd_inputs.solver.data_term.epsilon_start, cmd_inputs.solver.data_term.epsilon_end))
+                return false;
+            if (!(cmd_inputs.solver.data_term.epsilon_start > 0.0 && cmd_inputs.solver.data_term.epsilon_end > 0.0))
+            {
+                std::cerr << "the -epsilon values must be positive, got: " << value << std::endl;
+                return false;
+            }
+        }
+        else if (option == "-schedule")
+        {
+            if (!parseOptionValue(option, value, cmd_inputs.solver.data_term.steps, 0))
+                return false;
+        }
+        else if (option == "-convergence")
+        {
+            int convergence;
+            if (!parseOptionValue(option, value, convergence))
+                return false;
+            cmd_inputs.solver.convergence = (convergence != 0);
+        }
+        else if (option == "-iterations")
+        {
+            if (!parseOptionValue(option, value, cmd_inputs.iterations, 1))
+                return false;
+        }
+        else if (option == "-pyramid")
+        {
+            if (!parseOptionValue(option, value, cmd_inputs.pyramid_start))
+                return false;
+            if (cmd_inputs.pyramid_start != 0 && cmd_inputs.pyramid_start < 3)
+            {
+                std::cerr << "the -pyramid level must be at least 3 vertices wide, or 0 to disable it, got: " << value << std::endl;
+                return false;
+            }
+        }
+        else if (option == "-pyramid_iterations")
+        {
+            if (!parseOptionValue(option, value, cmd_inputs.pyramid_iterations, 1))
+                return false;
+        }
+        else if (option == "-quadtree")
+        {
+            if (!parseOptionValue(option, value, cmd_inputs.quadtree_level, 0, 11))
+                return false;
+        }
+        else if (option == "-quadtree_points")
+        {
+            if (!parseOptionValue(option, value, cmd_inputs.quadtree_points, 1))
+                return false;
+        }
+        else if (option == "-resolution")
+        {
+            if (!parseOptionValue(option, value, cmd_inputs.contour_resolution, 0))
+                return false;
+        }
+        else if (option == "-cache")
+        {
+            cmd_inputs.contour_cache = value;
+        }
+        else if (option == "-images")
+        {
+            if (!parse_visual_output(value, cmd_inputs.images))
+            {
+                std::cerr << "unknown image output: " << value << std::endl;
+                return false;
+            }
+        }
+        else if (option == "-format")
+        {
+            if (value == "txt")
+                cmd_inputs.format = WarpgridFormat::Text;
+            else if (value == "wgb")
+                cmd_inputs.format = WarpgridFormat::Binary;
+            else if (value == "both")
+                cmd_inputs.format = WarpgridFormat::Both;
+            else
+            {
+                std::cerr << "unknown warpgrid format: " << value << std::endl;
+                return false;
+            }
+        }
+        else if (option == "-samples")
+        {
+            if (!parseOptionValue(option, value, cmd_inputs.sample_budget, 0))
+                return false;
+        }
+        else if (option == "-spacing")
+        {
+            if (!parseOptionValue(option, value, cmd_inputs.sample_spacing, 0.0f))
+                return false;
+        }
+        else if (option == "-sweep")
+        {
+            // alpha:beta pairs separated by commas
+            std::istringstream pairs(value);
+            std::string pair;
+            while (std::getline(pairs, pair, ','))
+            {
+                size_t colon = pair.find(':');
+                if (colon == std::string::npos)
+                {
+                    std::cerr << "expected alpha:beta in -sweep, got: " << pair << std::endl;
+                    return false;
+                }
+                float alpha, beta;
+                if (!parseOptionValue(option, pair.substr(0, colon), alpha) || !parseOptionValue(option, pair.substr(colon + 1), beta))
+                    return false;
+                cmd_inputs.sweep.push_back(std::make_pair(alpha, beta));
+            }
+        }
+        else
+        {
+            std::cerr << "unknown option for command warpgrid: " << option << std::endl;
+            return false;
+        }
+    }
     return true;
 }
 
@@ -75,42 +385,258 @@ int Warpgrid::computeWarpgridFromMaps(int argc, char* argv[])
 	int alpha = 200;
 	int beta = 4000;
 
-	if (argc >= 7)
+	int first_option = 6;
+	if (argc >= 9 && argv[6][0] != '-')
 	{
 		grid_size	= std::stoi(std::string(argv[6]));
 		alpha		= std::stof(std::string(argv[7]));
 		beta		= std::stof(std::string(argv[8]));
+		first_option = 9;
 	}
 
     // read cmd inputs
-    Params cmd_inputs =
-    {
-		mat1,
-		mat2,
-		std::to_string(alpha),
-		std::to_string(beta),
-		grid_size,
-		alpha,
-		beta
-    };
+    Params cmd_inputs;
+    cmd_inputs.filename_P = mat1;
+    cmd_inputs.filename_Q = mat2;
+    cmd_inputs.alpha_str = std::to_string(alpha);
+    cmd_inputs.beta_str = std::to_string(beta);
+    cmd_inputs.grid_size = grid_size;
+    cmd_inputs.alpha = alpha;
+    cmd_inputs.beta = beta;
+
+    if (!parseWarpgridOptions(argc, argv, first_option, cmd_inputs))
+    {
+        exit(EXIT_FAILURE);
+    }
 
     // fill vectors
     std::vector<vec2> P_xy;
     std::vector<vec2> Q_xy;
 
-    if (!getContoursListFromMaps(mat1, mat_to_use1, P_xy))
+    if (!getContoursListFromMaps(mat1, mat_to_use1, P_xy, cmd_inputs.contour_resolution, cmd_inputs.contour_cache, cmd_inputs.images))
     {
         std::cerr << "cannot extract contour list from material: " << mat1 << std::endl;
         exit(EXIT_FAILURE);
     }
 
-    if (!getContoursListFromMaps(mat2, mat_to_use2, Q_xy))
+    if (!getContoursListFromMaps(mat2, mat_to_use2, Q_xy, cmd_inputs.contour_resolution, cmd_inputs.contour_cache, cmd_inputs.images))
     {
         std::cerr << "cannot extract contour list from material: " << mat2 << std::endl;
         exit(EXIT_FAILURE);
     }
 
+    // blue noise decimation of the (often near-duplicated) sub-pixel contour points,
+    // so that the solver cost scales with the budget rather than with the image detail
+    if (cmd_inputs.sample_budget > 0 || cmd_inputs.sample_spacing > 0.0f)
+    {
+        auto start = std::chrono::steady_clock::now();
+        size_t P_size = P_xy.size(), Q_size = Q_xy.size();
+        P_xy = eliminate_samples(P_xy, cmd_inputs.sample_budget, cmd_inputs.sample_spacing);
+        Q_xy = eliminate_samples(Q_xy, cmd_inputs.sample_budget, cmd_inputs.sample_spacing);
+        std::cout << "Sample elimination: " << P_size << " -> " << P_xy.size() << " contour points in P, "
+            << Q_size << " -> " << Q_xy.size() << " in Q ("
+            << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s)" << std::endl;
+    }
+
     compute_and_serialize_warpgrid(P_xy, Q_xy, cmd_inputs);
 
     return EXIT_SUCCESS;
+}
+
+// contour points of a material for a map mask, extracted once and shared by all the pairs using them
+struct batchContours {
+    std::vector<vec2> points;
+    bool extracted = false;
+    double seconds = 0.0;
+};
+
+// a line "mat1 XXXXX mat2 XXXXX [grid_size alpha beta]" of the manifest
+struct batchPair {
+    std::string mat[2];
+    std::string maskName[2]; // as written in the manifest
+    int mask[2];
+    int grid_size = 128;
+    int alpha = 200;
+    int beta = 4000;
+    int line = 0;            // in the manifest
+    std::string suffix;      // of the outputs, when several lines pair the same materials
+
+    // filled by the solve
+    bool solved = false;
+    double seconds = 0.0;
+};
+
+int Warpgrid::computeWarpgridBatch(int argc, char* argv[])
+{
+    std::string manifest = argv[2];
+
+    // -threads is the size of the worker pool, the other options apply to every pair
+    unsigned int workers = std::max(1u, hardware_threads() / 2); // a decoupled solve already uses two threads
+    std::vector<char*> options = { argv[0], argv[1], argv[2] };
+    for (int i = 3; i < argc; i++)
+    {
+        if (std::string(argv[i]) == "-threads" && i + 1 < argc)
+        {
+            int threads;
+            if (!parseOptionValue("-threads", argv[++i], threads, 1))
+                exit(EXIT_FAILURE);
+            workers = (unsigned int)threads;
+        }
+        else
+            options.push_back(argv[i]);
+    }
+
+    Params shared_inputs;
+    shared_inputs.images = VisualOutput::Preview; // the antialiased rasters are opt-in for a batch
+    if (!parseWarpgridOptions(int(options.size()), options.data(), 3, shared_inputs))
+    {
+        exit(EXIT_FAILURE);
+    }
+
+    // 1 - read the manifest
+    std::ifstream infile(manifest);
+    if (!infile.is_open())
+    {
+        std::cerr << "failed to open the manifest: " << manifest << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    // a mask is one 0 or 1 per map, see getContoursListFromMaps
+    auto valid_mask = [](std::string const& mask) {
+        return !mask.empty() && mask.size() <= 5 && mask.find_first_not_of("01") == std::string::npos;
+    };
+
+    std::vector<batchPair> pairs;
+    unsigned int skipped = 0;
+    std::string line;
+    for (int line_number = 1; getline(infile, line); line_number++)
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        std::istringstream line_stream(line);
+        batchPair pair;
+        pair.line = line_number;
+        if (!(line_stream >> pair.mat[0]))
+            continue; // whitespace only
+        bool valid = (line_stream >> pair.maskName[0] >> pair.mat[1] >> pair.maskName[1])
+            && valid_mask(pair.maskName[0]) && valid_mask(pair.maskName[1]);
+
+        // then either nothing or the three numbers, and nothing after them
+        std::string trailing;
+        if (valid && !(line_stream >> std::ws).eof())
+            valid = (line_stream >> pair.grid_size >> pair.alpha >> pair.beta) && pair.grid_size >= 3
+                && !(line_stream >> trailing);
+        if (!valid)
+        {
+            std::cerr << manifest << ":" << line_number << ": expected mat1_folder XXXXX mat2_folder XXXXX [grid_size alpha beta], skipped" << std::endl;
+            skipped++;
+            continue;
+        }
+        pair.mask[0] = std::stoi(pair.maskName[0], nullptr, 2);
+        pair.mask[1] = std::stoi(pair.maskName[1], nullptr, 2);
+        pairs.push_back(pair);
+    }
+    infile.close();
+
+    // the outputs are named after the materials: the lines pairing the same materials get the masks,
+    // grid size and weights as a suffix, and the repeated lines are skipped
+    std::map<std::pair<std::string, std::string>, int> uses;
+    for (batchPair const& pair : pairs)
+        uses[std::make_pair(pair.mat[0], pair.mat[1])]++;
+    std::set<std::string> names;
+    for (auto it = pairs.begin(); it != pairs.end();)
+    {
+        if (uses[std::make_pair(it->mat[0], it->mat[1])] > 1)
+            it->suffix = "_" + it->maskName[0] + "_" + it->maskName[1] + "_" + std::to_string(it->grid_size)
+                + "_a" + std::to_string(it->alpha) + "_b" + std::to_string(it->beta);
+        if (!names.insert(it->mat[0] + "_" + it->mat[1] + it->suffix).second)
+        {
+            std::cerr << manifest << ":" << it->line << ": repeats an earlier pair, skipped" << std::endl;
+            skipped++;
+            it = pairs.erase(it);
+        }
+        else
+            ++it;
+    }
+
+    std::cout << "batch of " << pairs.size() << " warpgrids from " << manifest << std::endl;
+
+    // 2 - extract the contours of each (material, map mask) once, the maps of a material are
+    // extracted concurrently by getContoursListFromMaps
+    std::map<std::pair<std::string, int>, batchContours> contours;
+    for (batchPair const& pair : pairs)
+    {
+        for (unsigned int m = 0; m < 2; m++)
+        {
+            std::pair<std::string, int> key(pair.mat[m], pair.mask[m]);
+            if (contours.count(key)) continue;
+
+            batchContours& c = contours[key];
+            auto start = std::chrono::steady_clock::now();
+            c.extracted = getContoursListFromMaps(pair.mat[m], pair.mask[m], c.points, shared_inputs.contour_resolution, shared_inputs.contour_cache, shared_inputs.images);
+            if (!c.extracted)
+                std::cerr << "cannot extract contour list from material: " << pair.mat[m] << std::endl;
+            else if (shared_inputs.sample_budget > 0 || shared_inputs.sample_spacing > 0.0f)
+                c.points = eliminate_samples(c.points, shared_inputs.sample_budget, shared_inputs.sample_spacing);
+            c.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+    }
+
+    // 3 - solve the pairs in a pool of workers, the pairs are handed out one at a time
+    auto start = std::chrono::steady_clock::now();
+    parallel_for(0, pairs.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+        {
+            batchPair& pair = pairs[i];
+            batchContours const& P = contours.at(std::make_pair(pair.mat[0], pair.mask[0]));
+            batchContours const& Q = contours.at(std::make_pair(pair.mat[1], pair.mask[1]));
+            if (!P.extracted || !Q.extracted)
+                continue;
+
+            Params cmd_inputs = shared_inputs;
+            cmd_inputs.filename_P = pair.mat[0];
+            cmd_inputs.filename_Q = pair.mat[1];
+            cmd_inputs.output_suffix = pair.suffix;
+            cmd_inputs.alpha_str = std::to_string(pair.alpha);
+            cmd_inputs.beta_str = std::to_string(pair.beta);
+            cmd_inputs.grid_size = pair.grid_size;
+            cmd_inputs.alpha = pair.alpha;
+            cmd_inputs.beta = pair.beta;
+            cmd_inputs.solver.threads = std::max(1u, hardware_threads() / workers); // the neighbor searches share the pool
+
+            auto pairStart = std::chrono::steady_clock::now();
+            compute_and_serialize_warpgrid(P.points, Q.points, cmd_inputs);
+            pair.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - pairStart).count();
+            pair.solved = true;
+        }
+    }, 1, workers);
+    double total = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // 4 - summary, also written next to the outputs
+    std::ostringstream summary;
+    summary << "# material P, mask P, material Q, mask Q, grid size, alpha, beta, points P, points Q, contours P (s), contours Q (s), solve (s), status" << std::endl;
+    unsigned int failed = skipped;
+    for (batchPair const& pair : pairs)
+    {
+        batchContours const& P = contours.at(std::make_pair(pair.mat[0], pair.mask[0]));
+        batchContours const& Q = contours.at(std::make_pair(pair.mat[1], pair.mask[1]));
+        summary << pair.mat[0] << ", " << pair.maskName[0] << ", " << pair.mat[1] << ", " << pair.maskName[1] << ", "
+            << pair.grid_size << ", " << pair.alpha << ", " << pair.beta << ", "
+            << P.points.size() << ", " << Q.points.size() << ", " << P.seconds << ", " << Q.seconds << ", "
+            << pair.seconds << ", " << (pair.solved ? "solved" : "failed") << std::endl;
+        if (!pair.solved) failed++;
+    }
+
+    std::cout << summary.str()
+        << pairs.size() + skipped - failed << "/" << pairs.size() + skipped << " warpgrids solved with " << workers << " workers in " << total << " s"
+        << " (" << contours.size() << " contour extractions)" << std::endl;
+
+    std::ofstream summary_file("warp_batch_summary.txt");
+    if (summary_file.is_open())
+        summary_file << summary.str();
+    else
+        std::cerr << "could not write warp_batch_summary.txt" << std::endl;
+
+    return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
\ No newline at end of file
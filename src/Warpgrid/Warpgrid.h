@@ -7,6 +7,7 @@
 #include <math.h>
 
 #include "Warpgrid/Solver.h"
+#include "Warpgrid/WarpgridFile.h"
 #include "Utils/MathUtils.h"
 
 using std::vector;
@@ -30,28 +31,25 @@ public:
 
     static int computeWarpgridFromMaps(int argc, char* argv[]);
 
+    // warpgrid-batch manifest.txt: solves all the pairs of the manifest, see printUsageForExecutable
+    static int computeWarpgridBatch(int argc, char* argv[]);
+
+    // convert in out: converts a warpgrid between the text (.txt) and binary (.wgb) formats
+    static int convertWarpgridFile(int argc, char* argv[]);
+
     bool isLoaded() { return loaded; }
     unsigned int getNumberOfVertices() { return nvertices; }
     unsigned int getGridSideWidth() { return int(sqrt(nvertices)); }
-    const vector<float>& getPointDataConstRef() { return pointsData; }
+    // interleaved x,y of the vertices, mapped from a .wgb file or parsed from a text file
+    const float* getPointData() const { return mapped.side() ? mapped.data() : pointsData.data(); }
 
 protected:
     unsigned int nvertices, nfaces, nedges;
     bool loaded;
     vector<float> pointsData;
+    mappedWarpgrid mapped;
 
 private:
-    bool loadTxtFile(const std::string &);
-    
-    static bool get_next_uncommented_line(std::ifstream &infile, std::string &result)
-    {
-        while (getline(infile, result))
-        {
-            if (result.length() >= 1 && result[0] != '#')
-            {
-                return true;
-            }
-        }
-        return false;
-    }
+    // .wgb files are mapped, the other files are read as text
+    bool loadFile(const std::string &);
 };
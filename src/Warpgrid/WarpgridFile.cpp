@@ -0,0 +1,251 @@
+#include "WarpgridFile.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char wgb_magic[4] = { 'W', 'G', 'B', '1' };
+static const uint32_t wgb_version = 1;
+
+struct wgbHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t N;
+    uint32_t element;
+    uint64_t bytes;
+    uint64_t checksum;
+};
+static_assert(sizeof(wgbHeader) == 32, "the payload of a .wgb file starts at 32 bytes");
+
+static uint64_t fnv1a_64(void const* data, size_t size)
+{
+    uint64_t hash = 14695981039346656037ull;
+    unsigned char const* bytes = static_cast<unsigned char const*>(data);
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+bool is_wgb_filename(std::string const& filename)
+{
+    return filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".wgb") == 0;
+}
+
+bool write_wgb(std::string const& filename, float const* rg, unsigned int N)
+{
+    wgbHeader header;
+    memcpy(header.magic, wgb_magic, 4);
+    header.version = wgb_version;
+    header.N = N;
+    header.element = uint32_t(wgbElement::Float32RG);
+    header.bytes = uint64_t(N) * N * 2 * sizeof(float);
+    header.checksum = fnv1a_64(rg, size_t(header.bytes));
+
+    FILE* file = fopen(filename.c_str(), "wb");
+    if (file == NULL)
+    {
+        std::cerr << "could not open file to write in: " << filename << std::endl;
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(rg, 1, size_t(header.bytes), file) == size_t(header.bytes);
+    ok = (fclose(file) == 0) && ok;
+    if (!ok)
+        std::cerr << "failed to write " << filename << std::endl;
+    return ok;
+}
+
+bool read_warpgrid_txt(std::string const& filename, std::vector<float>& rg)
+{
+    std::ifstream infile(filename, std::ios::binary);
+    if (!infile.is_open())
+    {
+        std::cerr << "failed to open the file: " << filename << std::endl;
+        return false;
+    }
+    std::string text((std::istreambuf_iterator<char>(infile)), std::istreambuf_iterator<char>());
+
+    // the uncommented lines, parsed in place
+    size_t pos = 0;
+    auto next_line = [&](char const*& line) {
+        while (pos < text.size())
+        {
+            size_t end = text.find('\n', pos);
+            if (end == std::string::npos) end = text.size();
+            line = text.c_str() + pos;
+            bool uncommented = end > pos && text[pos] != '#';
+            pos = end + 1;
+            if (uncommented) return true;
+        }
+        return false;
+    };
+
+    char const* line;
+    char* end;
+    if (!next_line(line))
+        return false;
+    unsigned long nvertices = strtoul(line, &end, 10);
+    if (end == line)
+    {
+        std::cerr << "expected the number of vertices in " << filename << std::endl;
+        return false;
+    }
+    // a vertex line "x y\n" takes at least 4 bytes, the last one maybe without its newline
+    if (nvertices > (text.size() - std::min(pos, text.size()) + 1) / 4)
+    {
+        std::cerr << "expected " << nvertices << " vertices in " << filename << ", the file is too short" << std::endl;
+        return false;
+    }
+
+    rg.resize(2 * size_t(nvertices));
+    for (size_t i = 0; i < nvertices; i++)
+    {
+        if (!next_line(line))
+        {
+            std::cerr << "expected " << nvertices << " vertices in " << filename << ", got " << i << std::endl;
+            return false;
+        }
+        // strtof skips the newlines too: y must be on the line of x
+        rg[2 * i] = strtof(line, &end);
+        char const* y = end;
+        while (*y == ' ' || *y == '\t') y++;
+        bool parsed = end != line && *y != '\n' && *y != '\r' && *y != '\0';
+        if (parsed)
+        {
+            rg[2 * i + 1] = strtof(y, &end);
+            parsed = end != y;
+        }
+        if (!parsed)
+        {
+            std::cerr << "expected the x y coordinates of vertex " << i << " in " << filename << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool write_warpgrid_txt(std::string const& filename, float const* rg, size_t nvertices)
+{
+    FILE* file = fopen(filename.c_str(), "w");
+    if (file == NULL)
+    {
+        std::cerr << "could not open file to write in: " << filename << std::endl;
+        return false;
+    }
+    fprintf(file, "%zu\n", nvertices);
+    for (size_t i = 0; i < nvertices; i++)
+        fprintf(file, "%.*g %.*g\n", std::numeric_limits<float>::max_digits10, rg[2 * i], std::numeric_limits<float>::max_digits10, rg[2 * i + 1]);
+    return fclose(file) == 0;
+}
+
+void mappedWarpgrid::close()
+{
+#ifdef _WIN32
+    if (_base) UnmapViewOfFile(_base);
+    if (_mapping) CloseHandle(_mapping);
+    if (_file) CloseHandle(_file);
+    _mapping = nullptr;
+    _file = nullptr;
+#else
+    if (_base) munmap(const_cast<unsigned char*>(_base), _size);
+#endif
+    _base = nullptr;
+    _size = 0;
+    _N = 0;
+}
+
+float const* mappedWarpgrid::data() const
+{
+    return _base ? reinterpret_cast<float const*>(_base + sizeof(wgbHeader)) : nullptr;
+}
+
+bool mappedWarpgrid::open(std::string const& filename, bool verify)
+{
+    close();
+
+#ifdef _WIN32
+    _file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (_file == INVALID_HANDLE_VALUE)
+    {
+        _file = nullptr;
+        std::cerr << "failed to open the file: " << filename << std::endl;
+        return false;
+    }
+    LARGE_INTEGER size;
+    GetFileSizeEx(_file, &size);
+    _size = size_t(size.QuadPart);
+    if (_size >= sizeof(wgbHeader))
+    {
+        _mapping = CreateFileMappingA(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (_mapping)
+            _base = static_cast<unsigned char const*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+    }
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        std::cerr << "failed to open the file: " << filename << std::endl;
+        return false;
+    }
+    struct stat status;
+    if (fstat(fd, &status) == 0 && size_t(status.st_size) >= sizeof(wgbHeader))
+    {
+        _size = size_t(status.st_size);
+        void* base = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (base != MAP_FAILED)
+            _base = static_cast<unsigned char const*>(base);
+    }
+    ::close(fd);
+#endif
+
+    if (_base == nullptr)
+    {
+        std::cerr << "failed to map the warpgrid file: " << filename << std::endl;
+        close();
+        return false;
+    }
+
+    wgbHeader header;
+    memcpy(&header, _base, sizeof(header));
+    uint64_t expected = uint64_t(header.N) * header.N * 2 * sizeof(float);
+    std::string error;
+    if (memcmp(header.magic, wgb_magic, 4) != 0)
+        error = "not a .wgb file";
+    else if (header.version != wgb_version)
+        error = "unsupported .wgb version " + std::to_string(header.version);
+    else if (header.element != uint32_t(wgbElement::Float32RG))
+        error = "unsupported .wgb element type " + std::to_string(header.element);
+    else if (header.bytes != expected || _size < sizeof(wgbHeader) + expected)
+        error = "truncated .wgb file";
+    else if (verify && fnv1a_64(_base + sizeof(wgbHeader), size_t(expected)) != header.checksum)
+        error = "checksum mismatch";
+
+    if (!error.empty())
+    {
+        std::cerr << error << ": " << filename << std::endl;
+        close();
+        return false;
+    }
+
+    _N = header.N;
+    return true;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Warpgrid files.
+//
+// The text format (.txt) is the number of vertices followed by the x y coordinates of one vertex per line,
+// row by row, lines starting with # are ignored.
+//
+// The binary format (.wgb) is a 32 byte header followed by the raw vertices, in the byte order of the machine:
+//   "WGB1" | version (uint32) | N (uint32, vertices per side) | element type (uint32) | payload size in bytes (uint64)
+//   | FNV-1a 64 checksum of the payload (uint64) | N*N x y pairs, row by row
+// With the float32 element type the payload is the layout of a GL_RG32F texture: a mapped file is uploaded as is.
+
+enum class wgbElement : uint32_t
+{
+    Float32RG = 1
+};
+
+// N*N vertices as interleaved x,y
+bool write_wgb(std::string const& filename, float const* rg, unsigned int N);
+
+// the vertices of a text warpgrid as interleaved x,y
+bool read_warpgrid_txt(std::string const& filename, std::vector<float>& rg);
+
+// writes the vertices with the digits needed to read back the same floats
+bool write_warpgrid_txt(std::string const& filename, float const* rg, size_t nvertices);
+
+bool is_wgb_filename(std::string const& filename);
+
+// a .wgb file mapped in memory, read-only: its vertices are read without parsing or copying
+class mappedWarpgrid {
+    unsigned char const* _base = nullptr;   // the mapped file
+    size_t _size = 0;
+#ifdef _WIN32
+    void* _file = nullptr;                  // handles of the file and of its mapping
+    void* _mapping = nullptr;
+#endif
+    unsigned int _N = 0;
+
+    void close();
+
+public:
+    mappedWarpgrid() = default;
+    mappedWarpgrid(mappedWarpgrid const&) = delete;
+    mappedWarpgrid& operator=(mappedWarpgrid const&) = delete;
+    ~mappedWarpgrid() { close(); }
+
+    // maps the file and checks its header, and its checksum if verify
+    bool open(std::string const& filename, bool verify = true);
+
+    unsigned int side() const { return _N; }
+    size_t vertexCount() const { return size_t(_N) * _N; }
+    float const* data() const;
+};
@@ -160,7 +160,7 @@ void MainWindow::openMaterial2()
 void MainWindow::openWarpGrid()
 {
 	QString path = QFileDialog::getOpenFileName(this,
-		tr("Open warp grid file"), current_path_, tr("File (*.txt)"));
+		tr("Open warp grid file"), current_path_, tr("Warp grid (*.txt *.wgb)"));
 	QFileInfo fileinfo(path);
 	if (fileinfo.exists())
 		viewer_widget_->loadWarpGrid(path);
@@ -15,11 +15,19 @@ void printUsageForExecutable()
 		<< " Description: Launch the GUI with default materials and warpgrid" << endl
 		<< "------------------" << endl
 		<< " ./MatMorpher gui material1_folder material2_folder warpgrid.txt" << endl
-		<< " Description: Launch the GUI with materials 1 and 2 and the warpgrid" << endl
+		<< " Description: Launch the GUI with materials 1 and 2 and the warpgrid (.txt or .wgb)" << endl
 		<< "------------------" << endl
-		<< " ./MatMorpher contours material_folder" << endl
+		<< " ./MatMorpher contours material_folder|library_folder|list.txt [options]" << endl
 		<< " Description: Apply contour detection on all maps inside material_folder" << endl
 		<< " and output results in the same folder as .pdf" << endl
+		<< " A library folder is searched recursively for the folders holding maps, a list names one material folder per line." << endl
+		<< " The maps are extracted by a pool of workers, and their contour and point counts and timings are written" << endl
+		<< " to contours_summary.csv" << endl
+		<< " -resolution n : resample the maps to n x n, 0 for their native size (default: 1024)" << endl
+		<< " -cache dir : reuse the contours of the maps already extracted into dir, and store the new ones (default: no cache)" << endl
+		<< " -threads n : number of workers (default: the hardware threads)" << endl
+		<< " -images none|preview|svg|polylines|raster : contour image of each map, a 512 preview png, an svg, a binary polyline" << endl
+		<< "  file, or the antialiased png (default: raster for a material folder, none for a library or list)" << endl
 		<< "------------------" << endl
 		<< " ./MatMorpher warpgrid mat1_folder XXXXX mat2_folder XXXXX grid_size alpha beta" << endl
 		<< " Description: Compute and output the warpgrid between material 1 and 2" << endl
@@ -29,6 +37,47 @@ void printUsageForExecutable()
 		<< " - grid_size is the height/width of the warpgrid(default: 128)" << endl
 		<< " - alpha modulates the interior regularity term(default: 4000)" << endl
 		<< " - beta modulates the periodic harmonicity term(default: 200)" << endl
+		<< " Options (after the arguments above):" << endl
+		<< " -layout decoupled|interleaved : solve x and y as two N^2 systems or one 2N^2 system (default: decoupled)" << endl
+		<< " -solver ldlt|lu|cg|lscg|pcg : LDLT or supernodal LU factorization, conjugate gradient preconditioned by an incomplete" << endl
+		<< "  Cholesky factorization, least squares conjugate gradient, or multigrid preconditioned conjugate gradient (default: ldlt)" << endl
+		<< " -precision double|mixed : factor the ldlt systems in double precision, or in single precision refined in double (default: double)" << endl
+		<< " -benchmark 0|1 : also solve the first system with every solver and report their time and memory (default: 0)" << endl
+		<< " -pcg_tolerance t : relative residual at which the iterative solvers stop (default: 1e-8)" << endl
+		<< " -knn grid|kdtree : periodic grid or kd-tree search of the closest target points (default: grid)" << endl
+		<< " -weight_cutoff c : prune the data equations weighted less than c times the largest weight, e.g. 1e-6 (default: 0, keep all)" << endl
+		<< " -iterations n : maximum number of IRLS iterations (default: 10)" << endl
+		<< " -kernel w[:w_end] : width of the gaussian kernel of the data term, annealed from w to w_end (default: 0.001)" << endl
+		<< " -p p[:p_end] : exponent of the data term (default: 0.1)" << endl
+		<< " -epsilon e[:e_end] : regularization of the data term exponent (default: 0.001)" << endl
+		<< " -schedule n : number of IRLS iterations over which the data term parameters are annealed (default: 0, the end values)" << endl
+		<< " -convergence 0|1 : write the convergence curve of the IRLS iterations to convergence_mat1_mat2.csv (default: 0)" << endl
+		<< " -tolerance t : IRLS stops when grid vertices and contour points move less than t grid cells (default: 0.25)" << endl
+		<< " -pyramid n : solve coarse to fine from a n x n grid (n >= 3), doubling up to grid_size (default: 0, disabled)" << endl
+		<< " -pyramid_iterations n : maximum number of IRLS iterations per pyramid level (default: 3)" << endl
+		<< " -quadtree l : solve an adaptive warpgrid refined up to 2^l cells per side where the contour points are dense," << endl
+		<< "  and resample it to grid_size (default: 0, uniform warpgrid)" << endl
+		<< " -quadtree_points n : split the cells of the adaptive warpgrid holding more than n contour points (default: 16)" << endl
+		<< " -resolution n : resample the maps to n x n for the contour extraction, 0 for their native size; maps larger" << endl
+		<< "  than 1024 are extracted in overlapping tiles in parallel, stitched across the tiles (default: 1024)" << endl
+		<< " -cache dir : reuse the contours of the maps already extracted into dir, and store the new ones (default: no cache)" << endl
+		<< " -images none|preview|svg|polylines|raster : output of the warpgrid and contour images (default: raster," << endl
+		<< "  preview for warpgrid-batch)" << endl
+		<< " -format txt|wgb|both : write the warpgrid as text warp_mat1_mat2.txt, binary warp_mat1_mat2.wgb, or both (default: txt)" << endl
+		<< " -samples n : keep n blue noise contour points per material by sample elimination (default: 0, keep all)" << endl
+		<< " -spacing d : or eliminate contour points closer than d in texture space (default: 0)" << endl
+		<< " -sweep a:b,a:b,... : solve for each alpha:beta pair, reusing the setup, outputs get the suffix _a<alpha>_b<beta>" << endl
+		<< "------------------" << endl
+		<< " ./MatMorpher warpgrid-batch manifest.txt [-threads n] [options]" << endl
+		<< " Description: Compute the warpgrids of all the pairs of the manifest, one pair per line:" << endl
+		<< " mat1_folder XXXXX mat2_folder XXXXX [grid_size alpha beta], lines starting with # are ignored" << endl
+		<< " The contours of each material and mask are extracted once, the pairs are solved by n workers" << endl
+		<< " (default: half the hardware threads), the warpgrid options above apply to every pair" << endl
+		<< " and the per-pair timings are written to warp_batch_summary.txt. The outputs of the lines pairing" << endl
+		<< " the same materials get the suffix _XXXXX_XXXXX_<grid_size>_a<alpha>_b<beta>, repeated lines are skipped" << endl
+		<< "------------------" << endl
+		<< " ./MatMorpher convert input output" << endl
+		<< " Description: Convert a warpgrid between the text (.txt) and binary (.wgb) formats, following the extensions" << endl
 	<< endl;
 }
 
@@ -89,8 +138,17 @@ int main(int argc, char* argv[])
 			}
 		}
 		else if (cmd == "warpgrid") {
-			// warpgrid clover4K 01000 fish4K 01000 128 200 4000
-			if (argc == 6 || argc == 9)
+			// warpgrid clover4K 01000 fish4K 01000 128 200 4000 -layout decoupled
+			int npositional = argc;
+			for (int i = 6; i < argc; i++)
+			{
+				if (argv[i][0] == '-')
+				{
+					npositional = i;
+					break;
+				}
+			}
+			if (npositional == 6 || npositional == 9)
 			{
 				Warpgrid warpgrid(argc, argv, WarpgridType::Compute);
 				return EXIT_SUCCESS;
@@ -101,6 +159,30 @@ int main(int argc, char* argv[])
 				return EXIT_FAILURE;
 			}
 		}
+		else if (cmd == "convert") {
+			// convert warp_clover_fish.txt warp_clover_fish.wgb
+			if (argc == 4)
+			{
+				return Warpgrid::convertWarpgridFile(argc, argv);
+			}
+			else
+			{
+				std::cerr << "expected an input and an output warpgrid for command convert" << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+		else if (cmd == "warpgrid-batch") {
+			// warpgrid-batch manifest.txt -threads 4 -pyramid 32
+			if (argc >= 3 && argv[2][0] != '-')
+			{
+				return Warpgrid::computeWarpgridBatch(argc, argv);
+			}
+			else
+			{
+				std::cerr << "missing manifest for command warpgrid-batch" << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
 		else {
 			std::cerr << "Unknown command '" << cmd << "'" << std::endl << std::endl;
 			printUsageForExecutable();